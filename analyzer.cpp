@@ -0,0 +1,328 @@
+#include <cmath>
+#include <queue>
+#include <functional>
+#include <algorithm>
+
+#include "analyzer.h"
+
+
+IncrementalAnalyzer::IncrementalAnalyzer(const Board &b, const SearchOptions &o)
+  : board(b), options(o) {
+  // every search starts over on the board as it is
+  options.checkpoint_file = "";
+  options.resume_file = "";
+  searches = 0;
+  path_valid = false;
+  grid_valid = false;
+  path_depth = 0;
+  computeGoalDistances();
+}
+
+
+// ==================================================================
+// ==================================================================
+// Wall edits
+
+void IncrementalAnalyzer::addHorizontalWall(double r, int c) {
+  checkHorizontalWall(r, c);
+  board.addHorizontalWall(r, c);
+  wallChanged(Position(floor(r), c), Position(floor(r) + 1, c), true);
+}
+
+void IncrementalAnalyzer::addVerticalWall(int r, double c) {
+  checkVerticalWall(r, c);
+  board.addVerticalWall(r, c);
+  wallChanged(Position(r, floor(c)), Position(r, floor(c) + 1), true);
+}
+
+void IncrementalAnalyzer::removeHorizontalWall(double r, int c) {
+  checkHorizontalWall(r, c);
+  board.removeHorizontalWall(r, c);
+  wallChanged(Position(floor(r), c), Position(floor(r) + 1, c), false);
+}
+
+void IncrementalAnalyzer::removeVerticalWall(int r, double c) {
+  checkVerticalWall(r, c);
+  board.removeVerticalWall(r, c);
+  wallChanged(Position(r, floor(c)), Position(r, floor(c) + 1), false);
+}
+
+void IncrementalAnalyzer::checkHorizontalWall(double r, int c) {
+  // a search that was cut short can't be vouched for
+  if (grid_valid && (grid_result.status != SEARCH_COMPLETE ||
+      reachesHorizontalWall(grid, options.max_moves == -1 ? -1 : options.max_moves - 1, r, c)))
+    grid_valid = false;
+  if (path_valid && (path_result.status != SEARCH_COMPLETE || path_grid.empty() ||
+      reachesHorizontalWall(path_grid, path_depth, r, c)))
+    path_valid = false;
+}
+
+void IncrementalAnalyzer::checkVerticalWall(int r, double c) {
+  if (grid_valid && (grid_result.status != SEARCH_COMPLETE ||
+      reachesVerticalWall(grid, options.max_moves == -1 ? -1 : options.max_moves - 1, r, c)))
+    grid_valid = false;
+  if (path_valid && (path_result.status != SEARCH_COMPLETE || path_grid.empty() ||
+      reachesVerticalWall(path_grid, path_depth, r, c)))
+    path_valid = false;
+}
+
+// The wall runs along the bottom of row floor(r). A robot in column c
+// reaches it moving south from above if the walls would let it slide at least
+// down to row floor(r), and likewise moving north from below.
+bool IncrementalAnalyzer::reachesHorizontalWall(const std::vector<std::vector<int> > &g, int max_depth,
+                                                double r, int c) const {
+  int above = floor(r);
+  for (int i = 1; i <= board.getRows(); ++i) {
+    int moves = g[i-1][c-1];
+    if (moves == -1 || (max_depth != -1 && moves > max_depth))
+      continue;
+    if (i <= above && board.slideTo(Position(i, c), "south").row >= above)
+      return true;
+    if (i > above && board.slideTo(Position(i, c), "north").row <= above + 1)
+      return true;
+  }
+  return false;
+}
+
+// Same as above, for the wall along the right side of column floor(c)
+bool IncrementalAnalyzer::reachesVerticalWall(const std::vector<std::vector<int> > &g, int max_depth,
+                                              int r, double c) const {
+  int left = floor(c);
+  for (int j = 1; j <= board.getCols(); ++j) {
+    int moves = g[r-1][j-1];
+    if (moves == -1 || (max_depth != -1 && moves > max_depth))
+      continue;
+    if (j <= left && board.slideTo(Position(r, j), "east").col >= left)
+      return true;
+    if (j > left && board.slideTo(Position(r, j), "west").col <= left + 1)
+      return true;
+  }
+  return false;
+}
+
+
+// ==================================================================
+// ==================================================================
+// Results
+
+const SearchResult &IncrementalAnalyzer::solution() {
+  if (path_valid)
+    return path_result;
+  // See if the goal distances can vouch for the answer without a search. The
+  // search's grid doesn't go with the answer then, so it's dropped.
+  int bound = goalBound();
+  BoardState replayed(&board);
+  if (bound == -1 || (options.max_moves != -1 && bound > options.max_moves)) {
+    // no robot that can win gets to the goal in time, even with nothing but
+    // the walls in its way
+    path_result = SearchResult();
+    path_result.lower_bound = (options.max_moves == -1) ? 0 : options.max_moves + 1;
+    path_valid = true;
+    path_grid.clear();
+    return path_result;
+  }
+  if (replaySolution(replayed) && replayed.moves[0].size() == bound) {
+    path_result.solutions[0] = replayed;
+    path_result.lower_bound = bound;
+    path_valid = true;
+    path_grid.clear();
+    return path_result;
+  }
+  path_result = bf_path_finder(&board, options);
+  searches++;
+  path_valid = true;
+
+  // Work out the deepest states the search expanded, and which cells robots
+  // stood on in them
+  path_grid.clear();
+  if (path_result.status != SEARCH_COMPLETE)
+    return path_result;
+  if (!path_result.solutions.empty())
+    path_depth = std::max((int)path_result.solutions[0].moves[0].size() - 1, 0);
+  else
+    path_depth = (options.max_moves == -1) ? -1 : options.max_moves - 1;
+  if (path_depth == -1) {
+    // nothing was left unexplored, same as the uncapped accessibility search
+    path_grid = accessibility();
+    if (grid_result.status != SEARCH_COMPLETE)
+      path_grid.clear();
+    return path_result;
+  }
+  SearchOptions capped(options);
+  capped.max_moves = path_depth;
+  SearchResult stats;
+  path_grid = bf_accessibility(&board, capped, &stats);
+  searches++;
+  if (stats.status != SEARCH_COMPLETE)
+    path_grid.clear();
+  return path_result;
+}
+
+const std::vector<std::vector<int> > &IncrementalAnalyzer::accessibility() {
+  if (grid_valid)
+    return grid;
+  grid = bf_accessibility(&board, options, &grid_result);
+  searches++;
+  grid_valid = true;
+  return grid;
+}
+
+// ==================================================================
+// ==================================================================
+// Goal distances
+
+void IncrementalAnalyzer::lineNeighbours(int cell, std::vector<int> &out) const {
+  static const int row_step[4] = { -1, 0, 1, 0 };
+  static const int col_step[4] = { 0, 1, 0, -1 };
+  int cols = board.getCols();
+  out.clear();
+  Position from(cell / cols + 1, cell % cols + 1);
+  for (int d = 0; d < 4; ++d) {
+    Position stop = board.slideTo(from, d);
+    Position pos = from;
+    while (pos != stop) {
+      pos = Position(pos.row + row_step[d], pos.col + col_step[d]);
+      out.push_back((pos.row - 1) * cols + (pos.col - 1));
+    }
+  }
+}
+
+// Breadth first search out from the goal
+void IncrementalAnalyzer::computeGoalDistances() {
+  int cols = board.getCols();
+  goal_distances = std::vector<std::vector<int> >(board.getRows(), std::vector<int>(cols, -1));
+  Position goal = board.getGoal();
+  int start = (goal.row - 1) * cols + (goal.col - 1);
+  distance(start) = 0;
+  std::queue<int> queued;
+  queued.push(start);
+  std::vector<int> next;
+  while (!queued.empty()) {
+    int cell = queued.front();
+    queued.pop();
+    lineNeighbours(cell, next);
+    for (int i = 0; i < next.size(); ++i) {
+      if (distance(next[i]) == -1) {
+        distance(next[i]) = distance(cell) + 1;
+        queued.push(next[i]);
+      }
+    }
+  }
+}
+
+// Only the cells on the wall's row or column gained or lost neighbours. A
+// removed wall can only bring distances down, so they go down from those
+// cells outwards. An added wall can only push them up: a cell has to be
+// worked out again if none of its neighbours one move closer to the goal is
+// still both its neighbour and sure of its own distance. Going through the
+// cells nearest first settles that for each one, and then just those cells
+// have their distances found again from the ones around them.
+void IncrementalAnalyzer::wallChanged(const Position &a, const Position &b, bool added) {
+  int rows = board.getRows();
+  int cols = board.getCols();
+  std::vector<int> line;
+  if (a.col == b.col) {
+    for (int i = 1; i <= rows; ++i)
+      line.push_back((i - 1) * cols + (a.col - 1));
+  }
+  else {
+    for (int j = 1; j <= cols; ++j)
+      line.push_back((a.row - 1) * cols + (j - 1));
+  }
+
+  // cells by distance, nearest first
+  typedef std::pair<int, int> Entry;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queued;
+  std::vector<int> next;
+  // affected[cell] is set for cells whose distance has to be found again
+  std::vector<bool> affected(rows * cols, !added);
+  if (added) {
+    for (int i = 0; i < line.size(); ++i) {
+      if (distance(line[i]) > 0)
+        queued.push(Entry(distance(line[i]), line[i]));
+    }
+    std::vector<int> lost;
+    while (!queued.empty()) {
+      Entry e = queued.top();
+      queued.pop();
+      if (affected[e.second])
+        continue;
+      lineNeighbours(e.second, next);
+      bool kept = false;
+      for (int i = 0; i < next.size() && !kept; ++i)
+        kept = !affected[next[i]] && distance(next[i]) == e.first - 1;
+      if (kept)
+        continue;
+      affected[e.second] = true;
+      lost.push_back(e.second);
+      for (int i = 0; i < next.size(); ++i) {
+        if (distance(next[i]) == e.first + 1)
+          queued.push(Entry(e.first + 1, next[i]));
+      }
+    }
+    for (int i = 0; i < lost.size(); ++i)
+      distance(lost[i]) = -1;
+    line = lost;
+  }
+
+  // Start each cell off from its neighbours, then carry any shorter distance
+  // on to the neighbours that can still change
+  for (int i = 0; i < line.size(); ++i) {
+    int cell = line[i];
+    if (distance(cell) == 0)
+      continue;
+    lineNeighbours(cell, next);
+    int best = distance(cell);
+    for (int j = 0; j < next.size(); ++j) {
+      int d = distance(next[j]);
+      if (d != -1 && (!added || !affected[next[j]]) && (best == -1 || d + 1 < best))
+        best = d + 1;
+    }
+    if (best != -1 && best != distance(cell)) {
+      distance(cell) = best;
+      queued.push(Entry(best, cell));
+    }
+  }
+  while (!queued.empty()) {
+    Entry e = queued.top();
+    queued.pop();
+    if (e.first != distance(e.second))
+      continue;
+    lineNeighbours(e.second, next);
+    for (int i = 0; i < next.size(); ++i) {
+      int &d = distance(next[i]);
+      if (affected[next[i]] && (d == -1 || d > e.first + 1)) {
+        d = e.first + 1;
+        queued.push(Entry(d, next[i]));
+      }
+    }
+  }
+}
+
+int IncrementalAnalyzer::goalBound() const {
+  int best = -1;
+  for (int i = 0; i < board.numRobots(); ++i) {
+    if (board.getGoalRobot() != -1 && board.getGoalRobot() != i)
+      continue;
+    Position p = board.getRobotPosition(i);
+    int d = goal_distances[p.row-1][p.col-1];
+    if (d != -1 && (best == -1 || d < best))
+      best = d;
+  }
+  return best;
+}
+
+bool IncrementalAnalyzer::replaySolution(BoardState &out) const {
+  if (options.all_paths || path_result.status != SEARCH_COMPLETE || path_result.solutions.empty())
+    return false;
+  const std::vector<std::pair<char, std::string> > &path = path_result.solutions[0].moves[0];
+  BoardState state(&board);
+  for (int i = 0; i < path.size(); ++i)
+    state = state.follow_edge(board.whichRobot(path[i].first), path[i].second);
+  if (path.empty())
+    state.moves.push_back(path);
+  if (!state.wins())
+    return false;
+  out = state;
+  return true;
+}
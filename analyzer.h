@@ -0,0 +1,101 @@
+#include <vector>
+
+#include "board.h"
+#include "boardstate.h"
+#include "search.h"
+
+#ifndef _analyzer_h_
+#define _analyzer_h_
+
+// ==================================================================
+// ==================================================================
+// Keeps the analysis of a board up to date while its walls are edited one at
+// a time, searching again only when an edit could have changed the answer.
+//
+// A wall only changes the moves that slide across it, or that it used to
+// stop. The cached accessibility grid says which cells any robot stood on
+// within a given number of moves, and the slide tables say how far a robot
+// on each of those cells can go. If none of those slides reach the edited
+// wall, every state the search looked at has exactly the same moves as
+// before, so the search would find exactly the same thing. To make that
+// check for the solution as well, the analyzer keeps a second grid counting
+// only the states the path search expanded (those with fewer moves than the
+// solution).
+//
+// The per cell goal distances are the fewest moves a robot on its own would
+// need to get to the goal if it could stop anywhere along a slide (-1 if it
+// can't get there at all). Robots only ever cut slides short, so no solution
+// is shorter than the distance of the nearest robot that can win, and that
+// gives a second way to keep the solution: if the old path still works after
+// the edit and is no longer than that bound, it is still a shortest one.
+// Being able to stop anywhere makes these distances the same both ways, and
+// a wall only changes which cells of its own row or column can see each
+// other, so after an edit only the distances that depend on that are worked
+// out again.
+
+class IncrementalAnalyzer {
+public:
+  IncrementalAnalyzer(const Board &board, const SearchOptions &options);
+
+  // Wall edits, as for the Board functions of the same names
+  void addHorizontalWall(double r, int c);
+  void addVerticalWall(int r, double c);
+  void removeHorizontalWall(double r, int c);
+  void removeVerticalWall(int r, double c);
+
+  const Board &getBoard() const { return board; }
+
+  // The results for the board as it is now. Each one is only searched for
+  // again if an edit since the last time could have changed it.
+  const SearchResult &solution();
+  const std::vector<std::vector<int> > &accessibility();
+  const std::vector<std::vector<int> > &goalDistances() const { return goal_distances; }
+
+  // how many path and accessibility searches have been run so far
+  int searchesRun() const { return searches; }
+
+private:
+  // whether some robot could slide across or be stopped by the wall, moving
+  // from a cell reached in at most max_depth moves according to grid
+  // (max_depth -1 for any cell reached)
+  bool reachesHorizontalWall(const std::vector<std::vector<int> > &grid, int max_depth,
+                             double r, int c) const;
+  bool reachesVerticalWall(const std::vector<std::vector<int> > &grid, int max_depth,
+                           int r, double c) const;
+  // drop whichever cached results the wall could change, before it is edited
+  void checkHorizontalWall(double r, int c);
+  void checkVerticalWall(int r, double c);
+  void computeGoalDistances();
+  // fix up the goal distances after the wall between cells a and b is added
+  // or removed
+  void wallChanged(const Position &a, const Position &b, bool added);
+  // the cells (numbered row by row from 0) a robot could stop on in one move
+  // from cell, if it could stop anywhere along the slide
+  void lineNeighbours(int cell, std::vector<int> &out) const;
+  int &distance(int cell) { return goal_distances[cell / board.getCols()][cell % board.getCols()]; }
+  // no solution uses fewer moves than this (-1 if there is none at all)
+  int goalBound() const;
+  // the cached solution replayed on the board as it is now, if it still
+  // gets to the goal in the same number of moves (for single paths only)
+  bool replaySolution(BoardState &out) const;
+
+  Board board;
+  SearchOptions options;
+  int searches;
+
+  // the latest results (not to be used unless marked valid)
+  SearchResult path_result;
+  bool path_valid;
+  std::vector<std::vector<int> > grid;
+  SearchResult grid_result;
+  bool grid_valid;
+  // accessibility of the states the path search expanded, and how many
+  // moves those take at most (-1 for all of them). Empty if it couldn't be
+  // worked out.
+  std::vector<std::vector<int> > path_grid;
+  int path_depth;
+
+  std::vector<std::vector<int> > goal_distances;
+};
+
+#endif
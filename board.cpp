@@ -2,6 +2,7 @@
 #include <iostream>
 #include <iomanip>
 #include <cstdlib>
+#include <cstdio>
 #include "board.h"
 
 
@@ -26,6 +27,16 @@ bool operator!=(const Position &a, const Position &b) {
   return !(a==b);
 }
 
+const char *const DIRECTIONS[4] = { "north", "east", "south", "west" };
+
+int directionIndex(const std::string &direction) {
+  for (int i = 0; i < 4; ++i) {
+    if (direction == DIRECTIONS[i])
+      return i;
+  }
+  return 255;
+}
+
 
 // ==================================================================
 // ==================================================================
@@ -40,6 +51,8 @@ Board::Board(int r, int c) {
   // initialize the dimensions
   rows = r; 
   cols = c; 
+  // no goal yet, and so no goal robot
+  goal_robot = -1;
 
   // allocate space for the contents of each grid cell
   board = std::vector<std::vector<char> >(rows,std::vector<char>(cols,' '));
@@ -58,6 +71,12 @@ Board::Board(int r, int c) {
   for (int i = 0; i < cols; i++) {
     horizontal_walls[0][i] = horizontal_walls[rows][i] = true;
   }
+
+  // with only the outer walls, every slide goes all the way to the edge
+  slide_north = std::vector<std::vector<int> >(rows,std::vector<int>(cols,1));
+  slide_south = std::vector<std::vector<int> >(rows,std::vector<int>(cols,rows));
+  slide_west = std::vector<std::vector<int> >(rows,std::vector<int>(cols,1));
+  slide_east = std::vector<std::vector<int> >(rows,std::vector<int>(cols,cols));
 }
 
 
@@ -87,6 +106,26 @@ bool Board::getVerticalWall(int r, double c) const {
   return vertical_walls[r-1][floor(c)];
 }
 
+// Where a robot slides to, ignoring the other robots
+Position Board::slideTo(const Position &p, const std::string &direction) const {
+  int d = directionIndex(direction);
+  if (d == 255)
+    return p;
+  return slideTo(p, d);
+}
+
+Position Board::slideTo(const Position &p, int direction) const {
+  assert (p.row >= 1 && p.row <= rows);
+  assert (p.col >= 1 && p.col <= cols);
+  switch (direction) {
+  case 0: return Position(slide_north[p.row-1][p.col-1], p.col);
+  case 1: return Position(p.row, slide_east[p.row-1][p.col-1]);
+  case 2: return Position(slide_south[p.row-1][p.col-1], p.col);
+  case 3: return Position(p.row, slide_west[p.row-1][p.col-1]);
+  }
+  return p;
+}
+
 
 // ===================
 // MODIFIERS related to board geometry
@@ -103,6 +142,7 @@ void Board::addHorizontalWall(double r, int c) {
   assert (horizontal_walls[floor(r)][c-1] == false);
   // subtract one and round down because the corner is (0,0) not (1,1)
   horizontal_walls[floor(r)][c-1] = true;
+  updateColumnSlides(c);
 }
 
 // Add an interior vertical wall
@@ -116,6 +156,31 @@ void Board::addVerticalWall(int r, double c) {
   assert (vertical_walls[r-1][floor(c)] == false);
   // subtract one and round down because the corner is (0,0) not (1,1)
   vertical_walls[r-1][floor(c)] = true;
+  updateRowSlides(r);
+}
+
+// Remove an interior horizontal wall
+void Board::removeHorizontalWall(double r, int c) {
+  // verify that the requested wall is valid and not on the edge
+  assert (fabs((r - floor(r))-0.5) < 0.005);
+  assert (r >= 1 && r <= rows);
+  assert (c >= 1 && c <= cols);
+  // verify that the wall exists
+  assert (horizontal_walls[floor(r)][c-1] == true);
+  horizontal_walls[floor(r)][c-1] = false;
+  updateColumnSlides(c);
+}
+
+// Remove an interior vertical wall
+void Board::removeVerticalWall(int r, double c) {
+  // verify that the requested wall is valid and not on the edge
+  assert (fabs((c - floor(c))-0.5) < 0.005);
+  assert (r >= 1 && r <= rows);
+  assert (c >= 1 && c <= cols);
+  // verify that the wall exists
+  assert (vertical_walls[r-1][floor(c)] == true);
+  vertical_walls[r-1][floor(c)] = false;
+  updateRowSlides(r);
 }
 
 
@@ -139,6 +204,35 @@ void Board::setspot(const Position &p, char a) {
   board[p.row-1][p.col-1] = a;
 }
 
+// Sweep down the column and back up, carrying along the row of the last
+// wall seen
+void Board::updateColumnSlides(int c) {
+  int stop = 1;
+  for (int i = 1; i <= rows; i++) {
+    if (horizontal_walls[i-1][c-1]) stop = i;
+    slide_north[i-1][c-1] = stop;
+  }
+  stop = rows;
+  for (int i = rows; i >= 1; i--) {
+    if (horizontal_walls[i][c-1]) stop = i;
+    slide_south[i-1][c-1] = stop;
+  }
+}
+
+// Same as above, across the row
+void Board::updateRowSlides(int r) {
+  int stop = 1;
+  for (int j = 1; j <= cols; j++) {
+    if (vertical_walls[r-1][j-1]) stop = j;
+    slide_west[r-1][j-1] = stop;
+  }
+  stop = cols;
+  for (int j = cols; j >= 1; j--) {
+    if (vertical_walls[r-1][j]) stop = j;
+    slide_east[r-1][j-1] = stop;
+  }
+}
+
 
 
 // ===================
@@ -279,28 +373,50 @@ void Board::setGoal(const std::string &gr, const Position &p) {
 // ==================================================================
 
 void Board::print() {
+  // the whole frame is built up in one buffer (kept between calls, so it is
+  // only allocated once) and written out in one go
+  render(frame);
+  std::cout.write(frame.data(), frame.size());
+}
+
+void Board::render(std::string &out) const {
+  // every line of text is 4 characters per column plus a few more
+  int width = 4 * cols + 8;
+  out.clear();
+  out.reserve((4 * rows + 2) * width);
+  char number[16];
 
   // print the column headings
-  std::cout << " ";
+  out += " ";
   for (int j = 1; j <= cols; j++) {
-    std::cout << std::setw(4) << j;
+    snprintf(number, sizeof(number), "%4d", j);
+    out += number;
   }
-  std::cout << "\n";
-  
+  out += "\n";
+
   // for each row
   for (int i = 0; i <= rows; i++) {
 
     // don't print row 0 (it doesnt exist, the first real row is row 1)
     if (i > 0) {
-      
+
       // note that each grid rows is printed as 3 rows of text, plus the separator
       // the first and third rows are blank except for vertical walls
       // the middle row has the row heading, the robot positions, and the goal
-      std::string first = "  ";
-      std::string middle;
+      size_t first = out.size();
+      out += "  ";
+      for (int j = 0; j <= cols; j++) {
+        if (j > 0)
+          out += "   ";
+        out += getVerticalWall(i,j+0.5) ? '|' : ' ';
+      }
+      out += "\n";
+      size_t first_end = out.size();
+
+      snprintf(number, sizeof(number), "%2d", i);
+      out += number;
       for (int j = 0; j <= cols; j++) {
-        if (j > 0) { 
-          first += "   "; 
+        if (j > 0) {
           // determine if a robot is current located in this cell, or
           // if this is the goal
           Position p(i,j);
@@ -314,34 +430,25 @@ void Board::print() {
             else c = tolower(getRobot(goal_robot));
           }
           // put a little space around the information so it's easier to read
-          middle += " ";
-          middle += c;
-          middle += " ";
+          out += ' ';
+          out += c;
+          out += ' ';
         }
         // the vertical walls
-        if (getVerticalWall(i,j+0.5)) {
-          first += "|";
-          middle += "|";
-        } else {
-          first += " ";
-          middle += " ";
-        }
+        out += getVerticalWall(i,j+0.5) ? '|' : ' ';
       }
+      out += "\n";
 
-      // output the three rows
-      std::cout << first << std::endl;
-      std::cout << std::setw(2) << i << middle << std::endl;
-      std::cout << first << std::endl;
+      // the third row is the same as the first
+      out.append(out, first, first_end - first);
     }
 
     // print the horizontal walls between rows
-    std::cout << "  +";
-    for (double j = 1; j <= cols; j++) {
-      (getHorizontalWall(i+0.5,j)) ? std::cout << "---" : std::cout << "   ";
-      std::cout << "+";
+    out += "  +";
+    for (int j = 1; j <= cols; j++) {
+      out += getHorizontalWall(i+0.5,j) ? "---" : "   ";
+      out += "+";
     }
-    std::cout << "\n";
+    out += "\n";
   }
 }
-
-
@@ -25,6 +25,15 @@ std::ostream& operator<<(std::ostream &ostr, const Position &p);
 bool operator==(const Position &a, const Position &b);
 bool operator!=(const Position &a, const Position &b);
 
+// The directions a robot can move in. Their order is the order moves are
+// tried in, and their index is how a direction is stored when it is packed.
+extern const char *const DIRECTIONS[4];
+// the index of a direction in DIRECTIONS (255 if it isn't one)
+int directionIndex(const std::string &direction);
+
+// the most robots a board can have (one per capital letter)
+const int MAX_ROBOTS = 26;
+
 
 // ==================================================================
 // ==================================================================
@@ -41,7 +50,7 @@ public:
 
   // CONSTRUCTOR
   Board(int num_rows, int num_cols);
-  Board() { rows = 0; cols = 0; }
+  Board() { rows = 0; cols = 0; goal_robot = -1; }
 
 
   // ACCESSORS related the board geometry
@@ -49,6 +58,11 @@ public:
   int getCols() const { return cols; }
   bool getHorizontalWall(double r, int c) const;
   bool getVerticalWall(int r, double c) const;
+  // where a robot starting at p stops when moved in direction, counting the
+  // walls but not any other robots (looked up in the slide tables)
+  Position slideTo(const Position &p, const std::string &direction) const;
+  // the same, with the direction given by its index in DIRECTIONS
+  Position slideTo(const Position &p, int direction) const;
 
   // ACCESSORS related to the robots and their current positions
   unsigned int numRobots() const { return robots.size(); }
@@ -70,6 +84,9 @@ public:
   // MODIFIERS related to board geometry
   void addHorizontalWall(double r, int c);
   void addVerticalWall(int r, double c);
+  // the outer edges of the board can't be removed
+  void removeHorizontalWall(double r, int c);
+  void removeVerticalWall(int r, double c);
 
   // MODIFIERS related robot position
   // initial placement of a new robot
@@ -83,6 +100,8 @@ public:
 
   // PRINT
   void print();
+  // the text print() writes out, put into out
+  void render(std::string &out) const;
   
   friend class BoardState;
 
@@ -92,6 +111,9 @@ private:
   // private helper functions
   char getspot(const Position &p) const;
   void setspot(const Position &p, char a);
+  // recompute the slide tables for one column / one row
+  void updateColumnSlides(int c);
+  void updateRowSlides(int r);
 
 
   // REPRESENTATION
@@ -102,6 +124,13 @@ private:
   std::vector<std::vector<char> > board;
   std::vector<std::vector<bool> > vertical_walls;
   std::vector<std::vector<bool> > horizontal_walls;
+  // For each cell, the row a robot there stops on moving north or south and
+  // the column it stops on moving east or west, if nothing but the walls is
+  // in its way. A wall only changes the entries in its own row or column.
+  std::vector<std::vector<int> > slide_north;
+  std::vector<std::vector<int> > slide_south;
+  std::vector<std::vector<int> > slide_east;
+  std::vector<std::vector<int> > slide_west;
 
   // information about the names and current positions of the robots
   std::vector<char> robots;
@@ -111,6 +140,9 @@ private:
   Position goal;
   // the goal robot is -1 if the puzzle is solved if any robot reaches the goal
   int goal_robot;
+
+  // buffer print() renders into
+  std::string frame;
 };
 
 
@@ -0,0 +1,508 @@
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+#include "boardstate.h"
+
+
+BoardState::BoardState(std::vector<Position> p, const Board *b, std::vector<std::vector<std::pair<char, std::string> > > m) {
+  board = b;
+  last_bot = -1;
+  for (int i = 0; i < p.size(); ++i) {
+    bots.push_back(p[i]);
+  }
+  for (int i = 0; i < m.size(); ++i) {
+    moves.push_back(std::vector<std::pair<char, std::string> >());
+    for (int j = 0; j < m[i].size(); ++j) {
+      moves[i].push_back(m[i][j]);
+    }
+  }
+}
+
+BoardState & BoardState::operator=(const BoardState &a) {
+  board = a.board;
+  bots = a.bots;
+  moves = a.moves;
+  last_bot = a.last_bot;
+  last_dir = a.last_dir;
+  last_from = a.last_from;
+  return *this;
+}
+
+std::ostream& operator<<(std::ostream &ostr, const BoardState &p) {
+  ostr << "(";
+  for (int i = 0; i < p.bots.size(); ++i) {
+    ostr << " "<< p.bots[i];
+  }
+  ostr << " )";
+  return ostr;
+}
+
+
+static bool robotAt(const std::vector<Position> &bots, Position pos) {
+  for (int i = 0; i < bots.size(); ++i) {
+    if (pos == bots[i])
+      return true;
+  }
+  return false;
+}
+
+// Modified to simulate a movement of a bot at some given coordinate in
+// some direction.
+bool BoardState::hasRobot(Position pos) const {
+  return robotAt(bots, pos);
+}
+
+// Gives position some robot would move to if it were to move in a given direction.
+Position BoardState::moveRobot(Position pos, const std::string &direction) const {
+  return moveRobot(pos, direction, bots);
+}
+
+// Same as above, but with the other robots at the positions given in b rather
+// than where they are in this state. The slide table gives how far the walls
+// let the robot go, and any robot in the way cuts that short.
+Position BoardState::moveRobot(Position pos, const std::string &direction, const std::vector<Position> &b) const {
+  Position new_pos = board->slideTo(pos, direction);
+  if (direction == "north") {
+    for (int i = 0; i < b.size(); ++i) {
+      if (b[i].col == pos.col && b[i].row < pos.row && b[i].row >= new_pos.row)
+        new_pos.row = b[i].row + 1;
+    }
+  }
+  else if (direction == "east") {
+    for (int i = 0; i < b.size(); ++i) {
+      if (b[i].row == pos.row && b[i].col > pos.col && b[i].col <= new_pos.col)
+        new_pos.col = b[i].col - 1;
+    }
+  }
+  else if (direction == "south") {
+    for (int i = 0; i < b.size(); ++i) {
+      if (b[i].col == pos.col && b[i].row > pos.row && b[i].row <= new_pos.row)
+        new_pos.row = b[i].row - 1;
+    }
+  }
+  else if (direction == "west") {
+    for (int i = 0; i < b.size(); ++i) {
+      if (b[i].row == pos.row && b[i].col < pos.col && b[i].col >= new_pos.col)
+        new_pos.col = b[i].col + 1;
+    }
+  }
+  return new_pos;
+}
+
+BoardState BoardState::follow_edge(int bot, std::string dir) {
+  std::vector<Position> p = bots;
+  p[bot] = moveRobot(bots[bot], dir);
+  std::vector<std::vector<std::pair<char, std::string> > > m = moves;
+  if (m.size() == 0) {
+    m.push_back(std::vector<std::pair<char, std::string> >());
+  }
+  
+  for (int i = 0; i < m.size(); ++i) {
+    m[i].push_back(std::pair<char, std::string>(board->getRobot(bot), dir));
+  }
+    
+  BoardState res(p, board, m);
+  res.last_bot = bot;
+  res.last_dir = dir;
+  res.last_from = bots[bot];
+  return res;
+}
+
+bool BoardState::wins() {
+  Position goal = board->getGoal();
+  if (board->getGoalRobot() == -1) {
+    for (int i = 0; i < board->numRobots(); ++i) {
+      if (bots[i] == goal)
+        return true;
+    }
+    return false;
+  }
+  else {
+    if (bots[board->getGoalRobot()] == goal)
+      return true;
+    else
+      return false;
+  }
+}
+
+static std::string opposite_direction(const std::string &dir) {
+  if (dir == "north") return "south";
+  if (dir == "south") return "north";
+  if (dir == "east") return "west";
+  return "east";
+}
+
+// Returns true if moving bot in dir (ending up at to) gives the same result
+// whether it happens before or after the last move. That is, bot ends up at
+// "to" even with the last moved robot back where it started, and the last moved
+// robot still ends up where it is now with bot already at "to".
+bool BoardState::commutes_with_last(int bot, const std::string &dir, const Position &to) const {
+  std::vector<Position> p = bots;
+  p[last_bot] = last_from;
+  if (moveRobot(bots[bot], dir, p) != to) {
+    return false;
+  }
+  p[bot] = to;
+  return moveRobot(last_from, last_dir, p) == bots[last_bot];
+}
+
+// ==================================================================
+// ==================================================================
+// Implementation of the BlockerPruner class
+
+// Beyond this many moves left, nearly every robot can get nearly anywhere,
+// so relevant doesn't bother looking
+static const int BLOCKER_MAX_BUDGET = 3;
+
+// relevant only looks at boards up to this many cells (32 by 32)
+static const int BLOCKER_MAX_CELLS = 1024;
+
+// how many layouts relevant keeps the answers for
+static const int RELEVANT_CACHE_SLOTS = 4096;
+
+typedef unsigned long long CellWord;
+
+BlockerPruner::BlockerPruner(const Board *board)
+  : num_robots(board->numRobots()), num_cells(board->getRows() * board->getCols()),
+    cols(board->getCols()), goal_cell(-1), goal_robot(board->getGoalRobot()), words(0) {
+  // (with no goal, distances stays empty and the pruner does nothing)
+  if (board->getGoal().row <= 0)
+    return;
+  goal_cell = (board->getGoal().row - 1) * cols + (board->getGoal().col - 1);
+  steps[0] = -cols;
+  steps[1] = 1;
+  steps[2] = cols;
+  steps[3] = -1;
+  for (int cell = 0; cell < num_cells; ++cell) {
+    for (int d = 0; d < 4; ++d) {
+      Position to = board->slideTo(Position(cell / cols + 1, cell % cols + 1), d);
+      stops.push_back((to.row - 1) * cols + (to.col - 1));
+    }
+  }
+
+  // A robot that can stop anywhere along a slide can get from a cell to any
+  // cell on the same line and back again, so the moves to the goal spread
+  // out from the goal along the lines.
+  distances.assign(num_cells, -1);
+  std::vector<int> queued(1, goal_cell);
+  distances[goal_cell] = 0;
+  for (int i = 0; i < queued.size(); ++i) {
+    int from = queued[i];
+    for (int d = 0; d < 4; ++d) {
+      for (int at = from; at != stops[from * 4 + d]; ) {
+        at += steps[d];
+        if (distances[at] == -1) {
+          distances[at] = distances[from] + 1;
+          queued.push_back(at);
+        }
+      }
+    }
+  }
+
+  if (num_cells > BLOCKER_MAX_CELLS)
+    return;
+  words = (num_cells <= 256) ? 4 : 16;
+  behind.assign(num_cells * 4, -1);
+  rays.assign(num_cells * 4 * words, 0);
+  lines.assign(num_cells * words, 0);
+  for (int cell = 0; cell < num_cells; ++cell) {
+    for (int d = 0; d < 4; ++d) {
+      CellWord *ray = &rays[(cell * 4 + d) * words];
+      CellWord *line = &lines[cell * words];
+      for (int at = cell; at != stops[cell * 4 + d]; at += steps[d]) {
+        ray[at / 64] |= 1ULL << (at % 64);
+        int ahead = at + steps[d];
+        line[ahead / 64] |= 1ULL << (ahead % 64);
+        if (at == cell)
+          behind[ahead * 4 + d] = cell;
+      }
+    }
+  }
+  cached.assign(RELEVANT_CACHE_SLOTS * (num_robots + 1), -1);
+  answers.resize(RELEVANT_CACHE_SLOTS);
+}
+
+BlockerPruner *newBlockerPruner(const Board *board, int pruning) {
+  if (!(pruning & PRUNE_BLOCKERS) || board->getGoal().row <= 0)
+    return NULL;
+  return new BlockerPruner(board);
+}
+
+int BlockerPruner::movesNeeded(const int *cells) const {
+  if (distances.empty())
+    return 0;
+  if (goal_robot != -1)
+    return distances[cells[goal_robot]];
+  int best = -1;
+  for (int i = 0; i < num_robots; ++i) {
+    int d = distances[cells[i]];
+    if (d != -1 && (best == -1 || d < best))
+      best = d;
+  }
+  return best;
+}
+
+unsigned int BlockerPruner::relevant(const int *cells, int budget) {
+  unsigned int all = (1U << num_robots) - 1;
+  if (budget < 0 || budget > BLOCKER_MAX_BUDGET || words == 0)
+    return all;
+  unsigned long long hash = budget;
+  for (int i = 0; i < num_robots; ++i)
+    hash = (hash ^ cells[i]) * 0x100000001b3ULL;
+  int slot = (hash ^ (hash >> 32)) % RELEVANT_CACHE_SLOTS;
+  int *entry = &cached[slot * (num_robots + 1)];
+  if (entry[0] == budget && std::equal(cells, cells + num_robots, entry + 1))
+    return answers[slot];
+  entry[0] = budget;
+  std::copy(cells, cells + num_robots, entry + 1);
+  if (words == 4)
+    answers[slot] = relevantWithin<4>(cells, budget);
+  else
+    answers[slot] = relevantWithin<16>(cells, budget);
+  return answers[slot];
+}
+
+// Puts the cells in set into out, returning how many there are
+template <int WORDS>
+static int list_cells(const CellWord *set, int *out) {
+  int n = 0;
+  for (int w = 0; w < WORDS; ++w) {
+    for (CellWord bits = set[w]; bits != 0; bits &= bits - 1)
+      out[n++] = w * 64 + __builtin_ctzll(bits);
+  }
+  return n;
+}
+
+static bool has(const CellWord *set, int cell) {
+  return (set[cell / 64] >> (cell % 64)) & 1;
+}
+
+// Whether robot i could be on the goal after its last move, with the cells
+// the robots could be on before it in reach. It could stop there if the
+// walls stop it there, or if some other robot could be just past it.
+template <int WORDS>
+bool BlockerPruner::reachesGoal(const CellWord (*reach)[WORDS], int i, int budget) const {
+  if (has(reach[i], goal_cell))
+    return true;
+  if (budget == 0)
+    return false;
+  for (int d = 0; d < 4; ++d) {
+    int past = goal_cell + steps[d];
+    bool stops_here = (stops[goal_cell * 4 + d] == goal_cell);
+    for (int j = 0; !stops_here && j < num_robots; ++j)
+      stops_here = (j != i && has(reach[j], past));
+    if (!stops_here)
+      continue;
+    // anywhere behind the goal along the slide will do
+    int back = (d + 2) % 4;
+    for (int at = goal_cell; at != stops[goal_cell * 4 + back]; ) {
+      at += steps[back];
+      if (has(reach[i], at))
+        return true;
+    }
+  }
+  return false;
+}
+
+// Where each robot could possibly be after up to budget - 1 moves of any
+// robots is worked out one move at a time. A robot can stop where the walls
+// stop it, or next to any cell some other robot could be on by then. A robot
+// that matters (one that could win with the last move, or sit on the line of
+// one that matters) makes every robot that could get onto one of its lines
+// matter too. Moving any of the others can never change how the ones that
+// matter slide, so a path that moves them could do without those moves and
+// wouldn't be shortest. (Only the robot on the goal moves last, so the rest
+// have to be where they are going a move before that.)
+//
+// The cells are kept as bits in WORDS words, the fewest the board fits in,
+// and the tables give the cells along each slide and next to each cell.
+template <int WORDS>
+unsigned int BlockerPruner::relevantWithin(const int *cells, int budget) const {
+  int n = num_robots;
+  CellWord reach[MAX_ROBOTS][WORDS];
+  CellWord next[MAX_ROBOTS][WORDS];
+  // the cells a robot moving each way would stop on with robot j in the way
+  CellWord stopped[MAX_ROBOTS][4][WORDS];
+  int list[BLOCKER_MAX_CELLS];
+  for (int i = 0; i < n; ++i) {
+    std::fill(reach[i], reach[i] + WORDS, 0ULL);
+    reach[i][cells[i] / 64] |= 1ULL << (cells[i] % 64);
+  }
+  for (int step = 0; step + 1 < budget; ++step) {
+    for (int j = 0; j < n; ++j) {
+      int count = list_cells<WORDS>(reach[j], list);
+      for (int d = 0; d < 4; ++d) {
+        std::fill(stopped[j][d], stopped[j][d] + WORDS, 0ULL);
+        for (int k = 0; k < count; ++k) {
+          int at = behind[list[k] * 4 + d];
+          if (at != -1)
+            stopped[j][d][at / 64] |= 1ULL << (at % 64);
+        }
+      }
+    }
+    for (int i = 0; i < n; ++i) {
+      CellWord blocked[4][WORDS];
+      for (int d = 0; d < 4; ++d) {
+        std::fill(blocked[d], blocked[d] + WORDS, 0ULL);
+        for (int j = 0; j < n; ++j) {
+          for (int w = 0; j != i && w < WORDS; ++w)
+            blocked[d][w] |= stopped[j][d][w];
+        }
+      }
+      std::copy(reach[i], reach[i] + WORDS, next[i]);
+      int count = list_cells<WORDS>(reach[i], list);
+      for (int k = 0; k < count; ++k) {
+        for (int d = 0; d < 4; ++d) {
+          const CellWord *ray = &rays[(list[k] * 4 + d) * WORDS];
+          for (int w = 0; w < WORDS; ++w)
+            next[i][w] |= ray[w] & blocked[d][w];
+          int stop = stops[list[k] * 4 + d];
+          next[i][stop / 64] |= 1ULL << (stop % 64);
+        }
+      }
+    }
+    for (int i = 0; i < n; ++i)
+      std::copy(next[i], next[i] + WORDS, reach[i]);
+  }
+
+  // the cells each robot could slide over or onto, from anywhere it could be
+  // (next isn't needed any more, so it holds them)
+  CellWord (*slides)[WORDS] = next;
+  for (int i = 0; i < n; ++i) {
+    std::fill(slides[i], slides[i] + WORDS, 0ULL);
+    int count = list_cells<WORDS>(reach[i], list);
+    for (int k = 0; k < count; ++k) {
+      const CellWord *line = &lines[list[k] * WORDS];
+      for (int w = 0; w < WORDS; ++w)
+        slides[i][w] |= line[w];
+    }
+  }
+
+  // start from the robots that could win, and spread out from there
+  unsigned int relevant = 0;
+  CellWord relevant_slides[WORDS] = { 0 };
+  for (int i = 0; i < n; ++i) {
+    if ((goal_robot == -1 || goal_robot == i) && reachesGoal<WORDS>(reach, i, budget)) {
+      relevant |= 1U << i;
+      for (int w = 0; w < WORDS; ++w)
+        relevant_slides[w] |= slides[i][w];
+    }
+  }
+  // (if nothing could win, nothing is worth moving)
+  bool changed = relevant != 0;
+  while (changed) {
+    changed = false;
+    for (int i = 0; i < n; ++i) {
+      if (relevant & (1U << i))
+        continue;
+      bool crosses = false;
+      for (int w = 0; w < WORDS; ++w)
+        crosses = crosses || (reach[i][w] & relevant_slides[w]) != 0;
+      if (crosses) {
+        relevant |= 1U << i;
+        for (int w = 0; w < WORDS; ++w)
+          relevant_slides[w] |= slides[i][w];
+        changed = true;
+      }
+    }
+  }
+  return relevant;
+}
+
+
+// ==================================================================
+// ==================================================================
+
+std::vector<BoardState> BoardState::get_adjacent(int pruning, int budget, BlockerPruner *blockers) {
+  std::vector<BoardState> res;
+  bool reorder = pruning & (PRUNE_REVERSE | PRUNE_COMMUTING);
+  bool bounded = (pruning & PRUNE_BLOCKERS) && budget != -1 && blockers != NULL;
+  int cells[MAX_ROBOTS];
+  unsigned int relevant = ~0U;
+  if (bounded) {
+    for (int i = 0; i < bots.size(); ++i)
+      cells[i] = (bots[i].row - 1) * board->getCols() + (bots[i].col - 1);
+    relevant = blockers->relevant(cells, budget);
+  }
+  for (int i = 0; i < bots.size(); ++i) {
+    if (!(relevant & (1U << i)))
+      continue;
+    for (int d = 0; d < 4; ++d) {
+      std::string dir = DIRECTIONS[d];
+      if (!reorder && !bounded) {
+        res.push_back(this->follow_edge(i, dir));
+        continue;
+      }
+      if (reorder && i == last_bot && (dir == last_dir || dir == opposite_direction(last_dir))) {
+        // Moving again the same way does nothing, and moving back lands either
+        // where we came from or somewhere we could have gone to directly.
+        continue;
+      }
+      Position to = moveRobot(bots[i], dir);
+      if (reorder && to == bots[i]) {
+        continue;
+      }
+      if ((pruning & PRUNE_COMMUTING) && last_bot != -1 && i != last_bot) {
+        int from_cell = (bots[i].row - 1) * board->getCols() + bots[i].col;
+        int last_cell = (last_from.row - 1) * board->getCols() + last_from.col;
+        if (from_cell < last_cell && commutes_with_last(i, dir, to)) {
+          continue;
+        }
+      }
+      if (bounded) {
+        // the goal has to be reachable in the moves left after this one
+        int moved = cells[i];
+        cells[i] = (to.row - 1) * board->getCols() + (to.col - 1);
+        int needed = blockers->movesNeeded(cells);
+        cells[i] = moved;
+        if (needed == -1 || needed >= budget) {
+          continue;
+        }
+      }
+      res.push_back(this->follow_edge(i, dir));
+    }
+  }
+  return res;
+}
+
+void BoardState::print_moves() {
+  int j;
+  for (int i = 0; i < moves.size(); ++i) {
+    for (j = 0; j < moves[i].size(); ++j) {
+      std::cout << "robot " << moves[i][j].first << " moves " << moves[i][j].second << "\n";
+    }
+    std::cout << "robot " << moves[i][j - 1].first << " reaches the goal after " 
+      << moves[i].size() << " moves\n";
+      std::cout << "\n";
+  }
+}
+
+
+void BoardState::merge_paths(const BoardState &b) {
+  moves.insert(moves.end(), b.moves.begin(), b.moves.end());
+}
+
+long BoardState::memory_usage() const {
+  long bytes = sizeof(BoardState) + bots.capacity() * sizeof(Position);
+  for (int i = 0; i < moves.size(); ++i) {
+    bytes += sizeof(moves[i]) + moves[i].capacity() * sizeof(std::pair<char, std::string>);
+  }
+  return bytes;
+}
+
+
+bool operator!=(const BoardState &a, const BoardState &b) {
+  return !(a == b);
+}
+
+bool operator==(const BoardState &a, const BoardState &b) {
+  if (a.bots.size() != b.bots.size()) {
+    return false;
+  }
+  for (int i = 0; i < a.bots.size(); ++i) {
+    if (a.bots[i] != b.bots[i]) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -10,14 +10,97 @@
 #ifndef _boardstate_h_
 #define _boardstate_h_
 
+// Flags for get_adjacent controlling which successors are skipped before they
+// are ever copied and looked up in the visited list.
+//   PRUNE_REVERSE   - drop moves that leave the robot where it is, and moves
+//                     that send the last moved robot straight back the way it
+//                     came. Neither can ever be part of a shortest path.
+//   PRUNE_COMMUTING - when the last move and a new move of a different robot
+//                     don't interfere with each other, only keep the order
+//                     where the robot starting on the lower numbered cell
+//                     moves first. The other order reaches the same state in
+//                     the same number of moves, so this is only safe when we
+//                     don't need to report every path (i.e. not -all_solutions).
+//   PRUNE_BLOCKERS  - don't move robots that can't make any difference to the
+//                     goal within the moves left, and drop moves after which
+//                     the goal is too far away for the moves left (see
+//                     BlockerPruner). Only used when get_adjacent is given
+//                     that budget and a BlockerPruner. Every shortest path
+//                     within the budget is kept, so this is safe with
+//                     -all_solutions too.
+const int PRUNE_NONE = 0;
+const int PRUNE_REVERSE = 1;
+const int PRUNE_COMMUTING = 2;
+const int PRUNE_BLOCKERS = 4;
+const int PRUNE_ALL = PRUNE_REVERSE | PRUNE_COMMUTING | PRUNE_BLOCKERS;
+
+// What PRUNE_BLOCKERS goes by, worked out once for a board and kept for a
+// whole search (the board mustn't change in the meantime). The robots are
+// given by the cells they are on, numbered row by row from 0. On a board
+// with no goal it does nothing: every robot is relevant and no move is too
+// far away.
+class BlockerPruner {
+public:
+  BlockerPruner(const Board *board);
+
+  // The fewest moves a robot that can win would need to get to the goal from
+  // cells if it could stop anywhere along a slide (-1 if none could ever get
+  // there). The other robots can only cut a slide short, so no solution from
+  // cells takes fewer moves.
+  int movesNeeded(const int *cells) const;
+  // Bit i is set if robot i could have anything to do with reaching the goal
+  // in budget more moves. A robot is left out when every place it could get
+  // to is off every line the robots that matter could slide along, so a
+  // shortest path never moves it. All bits are set when the budget is too
+  // big for this to be worth working out. The answers for the layouts asked
+  // about lately are kept, since iterative deepening comes back to the same
+  // states again and again.
+  unsigned int relevant(const int *cells, int budget);
+
+private:
+  template <int WORDS> unsigned int relevantWithin(const int *cells, int budget) const;
+  template <int WORDS>
+  bool reachesGoal(const unsigned long long (*reach)[WORDS], int robot, int budget) const;
+
+  int num_robots;
+  int num_cells;
+  int cols;
+  int goal_cell;
+  int goal_robot;
+  // where each cell slides to in each direction with nothing but the walls
+  // in the way (at cell * 4 + direction), how far one cell is from the next
+  // in each direction, and the moves from each cell as for movesNeeded
+  std::vector<int> stops;
+  int steps[4];
+  std::vector<int> distances;
+  // For relevant, sets of cells as bits in "words" words each: for each cell
+  // and direction, the cells a slide goes over before it stops (starting
+  // with the cell itself), and for each cell, the cells it could slide over
+  // or onto. behind gives the cell a robot moving that way would be stopped
+  // on by a robot on the cell (-1 if there's a wall in between).
+  int words;
+  std::vector<unsigned long long> rays;
+  std::vector<unsigned long long> lines;
+  std::vector<int> behind;
+  // the layouts relevant was asked about last, a slot each: the budget (-1
+  // if the slot is empty) followed by the cells, and what it answered
+  std::vector<int> cached;
+  std::vector<unsigned int> answers;
+};
+
+// A BlockerPruner for the board if pruning asks for PRUNE_BLOCKERS and the
+// board has a goal to prune toward, and NULL otherwise
+BlockerPruner *newBlockerPruner(const Board *board, int pruning);
+
 class BoardState
 {
 public:
-  BoardState(const Board *b) : board(b), bots(b->robot_positions) {}
+  BoardState(const Board *b) : board(b), bots(b->robot_positions), last_bot(-1) {}
   // BoardState(std::vector<Position> p, const Board *b, std::vector<std::vector<std::pair<char, std::string> > > m)
   //   : bots(p), board(b), moves(m) {}
   BoardState(std::vector<Position> p, const Board *b, std::vector<std::vector<std::pair<char, std::string> > > m);
-  BoardState(const BoardState &a) : board(a.board), bots(a.bots), moves(a.moves) {};
+  BoardState(const BoardState &a) : board(a.board), bots(a.bots), moves(a.moves),
+    last_bot(a.last_bot), last_dir(a.last_dir), last_from(a.last_from) {};
   
   BoardState & operator=(const BoardState &a);
   
@@ -26,13 +109,20 @@ public:
   
   bool hasRobot(Position pos) const;
   Position moveRobot(Position pos, const std::string &direction) const;
+  Position moveRobot(Position pos, const std::string &direction, const std::vector<Position> &b) const;
   
   // Follows edge between two nodes on the graph representing all possible states
   // on the board.
   BoardState follow_edge(int bot, std::string dir);
-  std::vector<BoardState> get_adjacent();
+  // budget is the number of moves left for reaching the goal from here (-1
+  // if unknown), used by PRUNE_BLOCKERS along with blockers
+  std::vector<BoardState> get_adjacent(int pruning = PRUNE_NONE, int budget = -1,
+                                       BlockerPruner *blockers = NULL);
+  bool commutes_with_last(int bot, const std::string &dir, const Position &to) const;
   void print_moves();
   void merge_paths(const BoardState &b);
+  // Rough number of bytes this state takes up, including its paths
+  long memory_usage() const;
   
   const Board *board;
   std::vector<Position> bots;
@@ -41,179 +131,17 @@ public:
   // need to report all the minimum paths to the end.
   
   std::vector<std::vector<std::pair<char, std::string> > > moves;
-    
+
+  // The last move made to reach this state (-1 if this is the starting state)
+  // and where that robot was before it moved. Used to prune successors.
+  int last_bot;
+  std::string last_dir;
+  Position last_from;
 };
 
 bool operator==(const BoardState &a, const BoardState &b);
-bool operator!=(const BoardState &a, const BoardState &b) { return !(a == b); }
-
-// Implementation only included in file because having it in another file
-// generated linker errors somehow, and I can't figure out why.
-
-BoardState::BoardState(std::vector<Position> p, const Board *b, std::vector<std::vector<std::pair<char, std::string> > > m) {
-  board = b;
-  for (int i = 0; i < p.size(); ++i) {
-    bots.push_back(p[i]);
-  }
-  for (int i = 0; i < m.size(); ++i) {
-    moves.push_back(std::vector<std::pair<char, std::string> >());
-    for (int j = 0; j < m[i].size(); ++j) {
-      moves[i].push_back(m[i][j]);
-    }
-  }
-}
-
-BoardState & BoardState::operator=(const BoardState &a) {
-  board = a.board;
-  bots = a.bots;
-  moves = a.moves;
-  return *this;
-}
-
-std::ostream& operator<<(std::ostream &ostr, const BoardState &p) {
-  ostr << "(";
-  for (int i = 0; i < p.bots.size(); ++i) {
-    ostr << " "<< p.bots[i];
-  }
-  ostr << " )";
-  return ostr;
-}
-
-
-// Modified to simulate a movement of a bot at some given coordinate in
-// some direction.
-bool BoardState::hasRobot(Position pos) const {
-  for (int i = 0; i < bots.size(); ++i) {
-    if (pos == bots[i])
-      return true;
-  }
-  return false;
-}
-// Gives position some robot would move to if it were to move in a given direction.
-Position BoardState::moveRobot(Position pos, const std::string &direction) const {
-  Position new_pos;
-  if(direction == "north") {
-    if (board->getHorizontalWall(pos.row - .5, pos.col) || hasRobot(Position(pos.row - 1, pos.col))) {
-      return pos;
-    }
-    for (double i = pos.row - 1.5; i > 0; --i) {
-      if (board->getHorizontalWall(i, pos.col) || hasRobot(Position(floor(i), pos.col))) {
-        new_pos = Position(ceil(i), pos.col);
-        break;
-      }
-    }
-  }
-  else if (direction == "east") {
-    if (board->getVerticalWall(pos.row, pos.col + .5) || hasRobot(Position(pos.row, pos.col + 1))) {
-      return pos;
-    }
-    for (double i = pos.col + 1.5; i <= board->cols + .5; ++i) {
-      if (board->getVerticalWall(pos.row, i) || hasRobot(Position(pos.row, ceil(i)))) {
-        new_pos = Position(pos.row, floor(i));
-        break;
-      }
-    }
-  }
-  else if (direction == "south") {
-    if (board->getHorizontalWall(pos.row + .5, pos.col) || hasRobot(Position(pos.row + 1, pos.col))) {
-      return pos;
-    }
-    for (double i = pos.row + 1.5; i <= board->rows + .5; ++i) {
-      if (board->getHorizontalWall(i, pos.col) || hasRobot(Position(ceil(i), pos.col))) {
-        new_pos = Position(floor(i), pos.col);
-        break;
-      }
-    }
-  }
-  else if (direction == "west") {
-    if (board->getVerticalWall(pos.row, pos.col - .5) || hasRobot(Position(pos.row, pos.col - 1))) {
-      return pos;
-    }
-    for (double i = pos.col - 1.5; i > 0; --i) {
-      if (board->getVerticalWall(pos.row, i) || hasRobot(Position(pos.row, floor(i)))) {
-        new_pos = Position(pos.row, ceil(i));
-        break;
-      }
-    }
-  }
-  else {
-    return pos;
-  }
-  return new_pos;
-}
-
-BoardState BoardState::follow_edge(int bot, std::string dir) {
-  std::vector<Position> p = bots;
-  p[bot] = moveRobot(bots[bot], dir);
-  std::vector<std::vector<std::pair<char, std::string> > > m = moves;
-  if (m.size() == 0) {
-    m.push_back(std::vector<std::pair<char, std::string> >());
-  }
-  
-  for (int i = 0; i < m.size(); ++i) {
-    m[i].push_back(std::pair<char, std::string>(board->getRobot(bot), dir));
-  }
-    
-  return BoardState(p, board, m);
-}
-
-bool BoardState::wins() {
-  Position goal = board->getGoal();
-  if (board->getGoalRobot() == -1) {
-    for (int i = 0; i < board->numRobots(); ++i) {
-      if (bots[i] == goal)
-        return true;
-    }
-    return false;
-  }
-  else {
-    if (bots[board->getGoalRobot()] == goal)
-      return true;
-    else
-      return false;
-  }
-}
-
-std::vector<BoardState> BoardState::get_adjacent() {
-  std::vector<BoardState> res;
-  for (int i = 0; i < bots.size(); ++i) {
-    res.push_back(this->follow_edge(i, "north"));
-    res.push_back(this->follow_edge(i, "east"));
-    res.push_back(this->follow_edge(i, "south"));
-    res.push_back(this->follow_edge(i, "west"));
-  }
-  return res;
-}
-
-void BoardState::print_moves() {
-  int j;
-  for (int i = 0; i < moves.size(); ++i) {
-    for (j = 0; j < moves[i].size(); ++j) {
-      std::cout << "robot " << moves[i][j].first << " moves " << moves[i][j].second << std::endl;
-    }
-    std::cout << "robot " << moves[i][j - 1].first << " reaches the goal after " 
-      << moves[i].size() << " moves" << std::endl;
-      std::cout << std::endl;
-  }
-}
-
-
-void BoardState::merge_paths(const BoardState &b) {
-  moves.insert(moves.end(), b.moves.begin(), b.moves.end());
-}
-
-
-bool operator==(const BoardState &a, const BoardState &b) {
-  if (a.bots.size() != b.bots.size()) {
-    return false;
-  }
-  for (int i = 0; i < a.bots.size(); ++i) {
-    if (a.bots[i] != b.bots[i]) {
-      return false;
-    }
-  }
-  return true;
-}
+bool operator!=(const BoardState &a, const BoardState &b);
+std::ostream& operator<<(std::ostream &ostr, const BoardState &p);
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,51 @@
+#include <string>
+#include <cstring>
+
+#ifndef _bytes_h_
+#define _bytes_h_
+
+// ==================================================================
+// ==================================================================
+// Reading and writing values as raw bytes, for the snapshot and puzzle
+// files. Everything is in the machine's own byte order.
+
+// Appends the bytes of a value to a buffer
+template <class T>
+void put(std::string &buf, T value) {
+  buf.append((const char *)&value, sizeof(T));
+}
+
+// Reads values back out of a buffer, noting if it runs off the end
+class Reader {
+public:
+  Reader(const std::string &b) : buf(b), pos(0), failed(false) {}
+
+  template <class T>
+  T get() {
+    T value = T();
+    if (pos + sizeof(T) > buf.size()) {
+      failed = true;
+      return value;
+    }
+    memcpy(&value, buf.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return value;
+  }
+
+  // a cell number (16 bits), which has to be on a board with this many cells
+  int cell(int num_cells) {
+    int value = get<unsigned short>();
+    if (value >= num_cells)
+      failed = true;
+    return failed ? 0 : value;
+  }
+
+  // the bytes not read yet
+  size_t left() const { return buf.size() - pos; }
+
+  const std::string &buf;
+  size_t pos;
+  bool failed;
+};
+
+#endif
@@ -0,0 +1,27 @@
+#!/bin/sh
+# Runs the puzzle generator and checks it writes the puzzles it was asked for,
+# each needing the number of moves asked for.
+#   sh check_generate.sh [path to the robots binary]
+robots=$(cd "$(dirname "${1:-./robots}")" && pwd)/$(basename "${1:-./robots}")
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+"$robots" -generate out -moves 5 -count 2
+status=$?
+if [ $status -ne 0 ]; then
+  echo "FAIL: -generate out -moves 5 -count 2 exited with $status"
+  exit 1
+fi
+for i in 1 2; do
+  puzzle=out_${i}_5moves.txt
+  if [ ! -f "$puzzle" ]; then
+    echo "FAIL: $puzzle wasn't written"
+    exit 1
+  fi
+  if [ "$("$robots" "$puzzle" -format compact | head -1)" != "1 x 5 moves" ]; then
+    echo "FAIL: $puzzle doesn't need 5 moves"
+    exit 1
+  fi
+done
+echo "generator ok"
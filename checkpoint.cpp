@@ -0,0 +1,356 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <unistd.h>
+
+#include "checkpoint.h"
+#include "bytes.h"
+
+
+// ==================================================================
+// ==================================================================
+// The file format. Everything is written in the machine's own byte order,
+// so snapshots are meant to be resumed on the machine that wrote them.
+//
+//   header:  magic, version, kind, max_moves, prune, board signature,
+//            number of robots
+//   record:  payload length, payload, RECORD_END
+//   payload: depth (of the states coming off the queue), states explored,
+//            number of states queued since the last record, then for each:
+//            number of the state it was reached from (NO_PARENT for the
+//            starting state), move (robot * 4 + direction, NO_MOVE for the
+//            starting state), robot cells
+//            number of states taken off the queue so far
+//            number of grid cells, then each grid value (the combined grid,
+//            followed by one for each robot if they are kept separately)
+//
+// Cells are numbered (row - 1) * cols + (col - 1) and stored in 16 bits.
+
+static const char MAGIC[8] = { 'R', 'R', 'S', 'N', 'A', 'P', 'S', 'H' };
+static const unsigned int VERSION = 2;
+static const unsigned int RECORD_END = 0x444E4552;
+static const unsigned long long NO_PARENT = ~0ULL;
+static const unsigned char NO_MOVE = 255;
+static const int HEADER_BYTES = sizeof(MAGIC) + 5 * sizeof(int) + sizeof(unsigned long long);
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the Checkpoint class
+
+Checkpoint::Checkpoint(const Board *b, const SearchOptions &options, int k) {
+  board = b;
+  kind = k;
+  max_moves = options.max_moves;
+  prune = options.prune;
+  checkpoint_file = options.checkpoint_file;
+  active = !checkpoint_file.empty();
+  interval = options.checkpoint_interval;
+  last_write = std::chrono::steady_clock::now();
+  resume_file = options.resume_file;
+  resume_bytes = 0;
+  first_write = true;
+  queued_count = 0;
+  taken_count = 0;
+  if (active && board->getRows() * board->getCols() > 65536) {
+    std::cerr << "WARNING: board is too big to checkpoint" << std::endl;
+    active = false;
+  }
+}
+
+// Hash of everything about the board the search depends on
+unsigned long long Checkpoint::signature() const {
+  unsigned long long h = 14695981039346656037ULL;
+  std::vector<int> values;
+  values.push_back(board->getRows());
+  values.push_back(board->getCols());
+  for (int i = 0; i < board->numRobots(); ++i) {
+    values.push_back(board->getRobot(i));
+    values.push_back(board->getRobotPosition(i).row);
+    values.push_back(board->getRobotPosition(i).col);
+  }
+  values.push_back(board->getGoal().row);
+  values.push_back(board->getGoal().col);
+  values.push_back(board->getGoalRobot());
+  for (int r = 0; r <= board->getRows(); ++r) {
+    for (int c = 1; c <= board->getCols(); ++c)
+      values.push_back(board->getHorizontalWall(r + 0.5, c));
+  }
+  for (int r = 1; r <= board->getRows(); ++r) {
+    for (int c = 0; c <= board->getCols(); ++c)
+      values.push_back(board->getVerticalWall(r, c + 0.5));
+  }
+  for (int i = 0; i < values.size(); ++i) {
+    h = (h ^ (unsigned int)values[i]) * 1099511628211ULL;
+  }
+  return h;
+}
+
+void Checkpoint::addState(const BoardState &s) {
+  int cols = board->getCols();
+  // (the state being expanded is always the last one taken off the queue)
+  put<unsigned long long>(pending, taken_count == 0 ? NO_PARENT : taken_count - 1);
+  put<unsigned char>(pending, s.last_bot == -1 ? NO_MOVE : s.last_bot * 4 + directionIndex(s.last_dir));
+  for (int i = 0; i < s.bots.size(); ++i) {
+    put<unsigned short>(pending, (s.bots[i].row - 1) * cols + (s.bots[i].col - 1));
+  }
+  queued_count++;
+}
+
+void Checkpoint::startDepth(int depth, const std::vector<std::vector<int> > *grid,
+                            const std::vector<std::vector<std::vector<int> > > *robot_grids, long explored) {
+  if (!active)
+    return;
+  std::chrono::duration<double> since = std::chrono::steady_clock::now() - last_write;
+  if (since.count() < interval)
+    return;
+  write(depth, grid, robot_grids, explored);
+  last_write = std::chrono::steady_clock::now();
+}
+
+void Checkpoint::stopped(int depth, const std::vector<std::vector<int> > *grid,
+                         const std::vector<std::vector<std::vector<int> > > *robot_grids, long explored) {
+  if (active)
+    write(depth, grid, robot_grids, explored);
+}
+
+void Checkpoint::write(int depth, const std::vector<std::vector<int> > *grid,
+                       const std::vector<std::vector<std::vector<int> > > *robot_grids, long explored) {
+  int cols = board->getCols();
+  int num_robots = board->numRobots();
+  std::string buf;
+  put<int>(buf, depth);
+  put<long long>(buf, explored);
+
+  int state_bytes = sizeof(unsigned long long) + 1 + num_robots * sizeof(unsigned short);
+  put<unsigned long long>(buf, pending.size() / state_bytes);
+  buf.append(pending);
+  put<unsigned long long>(buf, taken_count);
+
+  if (grid == NULL) {
+    put<unsigned int>(buf, 0);
+  }
+  else {
+    int layers = 1 + (robot_grids == NULL ? 0 : robot_grids->size());
+    put<unsigned int>(buf, layers * board->getRows() * cols);
+    for (int l = 0; l < layers; ++l) {
+      const std::vector<std::vector<int> > &g = (l == 0) ? *grid : (*robot_grids)[l-1];
+      for (int r = 0; r < g.size(); ++r) {
+        for (int c = 0; c < g[r].size(); ++c)
+          put<int>(buf, g[r][c]);
+      }
+    }
+  }
+
+  std::ofstream out;
+  if (first_write) {
+    if (resuming() && resume_file == checkpoint_file) {
+      // carry on where the snapshot left off, dropping any record that was
+      // only partly written
+      if (truncate(checkpoint_file.c_str(), resume_bytes) != 0) {
+        std::cerr << "WARNING: could not write checkpoint " << checkpoint_file << std::endl;
+        active = false;
+        return;
+      }
+      out.open(checkpoint_file.c_str(), std::ios::binary | std::ios::app);
+    }
+    else if (resuming()) {
+      // start the new file off with everything from the snapshot so far
+      std::ifstream in(resume_file.c_str(), std::ios::binary);
+      out.open(checkpoint_file.c_str(), std::ios::binary | std::ios::trunc);
+      std::vector<char> block(1 << 20);
+      long left = resume_bytes;
+      while (in && out && left > 0) {
+        in.read(block.data(), std::min<long>(left, block.size()));
+        out.write(block.data(), in.gcount());
+        left -= in.gcount();
+      }
+      if (left > 0)
+        out.setstate(std::ios::failbit);
+    }
+    else {
+      out.open(checkpoint_file.c_str(), std::ios::binary | std::ios::trunc);
+      std::string header(MAGIC, sizeof(MAGIC));
+      put<unsigned int>(header, VERSION);
+      put<int>(header, kind);
+      put<int>(header, max_moves);
+      put<int>(header, prune);
+      put<unsigned long long>(header, signature());
+      put<int>(header, num_robots);
+      out.write(header.data(), header.size());
+    }
+    first_write = false;
+  }
+  else {
+    out.open(checkpoint_file.c_str(), std::ios::binary | std::ios::app);
+  }
+
+  std::string length;
+  put<unsigned long long>(length, buf.size());
+  std::string end;
+  put<unsigned int>(end, RECORD_END);
+  out.write(length.data(), length.size());
+  out.write(buf.data(), buf.size());
+  out.write(end.data(), end.size());
+  out.flush();
+  if (!out) {
+    std::cerr << "WARNING: could not write checkpoint " << checkpoint_file << std::endl;
+    active = false;
+    return;
+  }
+  pending.clear();
+}
+
+bool Checkpoint::resume(VisitedSet *visited, std::deque<BoardState> &queue,
+                        std::vector<std::vector<int> > *grid,
+                        std::vector<std::vector<std::vector<int> > > *robot_grids,
+                        long &explored, std::string &error) {
+  std::ifstream in(resume_file.c_str(), std::ios::binary);
+  if (!in) {
+    error = "can't open " + resume_file;
+    return false;
+  }
+  in.seekg(0, std::ios::end);
+  unsigned long long file_bytes = in.tellg();
+  in.seekg(0, std::ios::beg);
+  int cols = board->getCols();
+  int num_robots = board->numRobots();
+  int num_cells = board->getRows() * cols;
+
+  std::string header(HEADER_BYTES, '\0');
+  in.read(&header[0], HEADER_BYTES);
+  if (in.gcount() != HEADER_BYTES || memcmp(header.data(), MAGIC, sizeof(MAGIC)) != 0) {
+    error = resume_file + " is not a snapshot";
+    return false;
+  }
+  Reader h(header);
+  h.pos = sizeof(MAGIC);
+  if (h.get<unsigned int>() != VERSION) {
+    error = resume_file + " is from a different version";
+    return false;
+  }
+  int file_kind = h.get<int>();
+  int file_max_moves = h.get<int>();
+  int file_prune = h.get<int>();
+  unsigned long long file_signature = h.get<unsigned long long>();
+  int file_robots = h.get<int>();
+  if (file_signature != signature() || file_robots != num_robots) {
+    error = resume_file + " is for a different puzzle";
+    return false;
+  }
+  if (file_kind != kind || file_max_moves != max_moves || file_prune != prune) {
+    error = resume_file + " is for a different kind of search";
+    return false;
+  }
+  resume_bytes = HEADER_BYTES;
+
+  // Every state queued so far, in order: the state it was reached from, the
+  // move, its depth and the cell of each robot. The queue and grid from the
+  // last complete record are the ones we want.
+  std::vector<unsigned long long> parents;
+  std::vector<unsigned char> moves;
+  std::vector<int> depths;
+  std::vector<unsigned short> cells;
+  unsigned long long taken = 0;
+  int state_bytes = sizeof(unsigned long long) + 1 + num_robots * sizeof(unsigned short);
+  int records = 0;
+  std::string buf;
+  while (true) {
+    unsigned long long length = 0;
+    in.read((char *)&length, sizeof(length));
+    // (a length running past the end of the file means the record is cut off)
+    if (in.gcount() != sizeof(length) ||
+        length > file_bytes - resume_bytes - sizeof(length))
+      break;
+    buf.resize(length);
+    in.read(&buf[0], length);
+    unsigned int end = 0;
+    in.read((char *)&end, sizeof(end));
+    if (!in || end != RECORD_END)
+      break;
+
+    Reader r(buf);
+    int depth = r.get<int>();
+    explored = r.get<long long>();
+    unsigned long long num_new = r.get<unsigned long long>();
+    if (num_new > r.left() / state_bytes)
+      r.failed = true;
+    BoardState s(board);
+    for (unsigned long long i = 0; i < num_new && !r.failed; ++i) {
+      unsigned long long n = parents.size();
+      unsigned long long parent = r.get<unsigned long long>();
+      int move = r.get<unsigned char>();
+      // only the first state has no parent, and every other one comes from
+      // a state before it
+      if (n == 0 ? (parent != NO_PARENT || move != NO_MOVE) :
+          (parent >= n || move == NO_MOVE || move / 4 >= num_robots))
+        r.failed = true;
+      for (int j = 0; j < num_robots; ++j) {
+        int cell = r.cell(num_cells);
+        cells.push_back(cell);
+        s.bots[j] = Position(cell / cols + 1, cell % cols + 1);
+      }
+      if (r.failed)
+        break;
+      parents.push_back(parent);
+      moves.push_back(move);
+      depths.push_back(n == 0 ? 0 : depths[parent] + 1);
+      visited->insert(s, depths.back());
+    }
+    taken = r.get<unsigned long long>();
+    if (taken > parents.size())
+      r.failed = true;
+    // The record was written with the states of depth coming off the queue
+    // next, or just after the last of them came off, so the depths traced
+    // back have to put it between the last state taken and the next one.
+    else if ((taken > 0 && depths[taken - 1] > depth) ||
+             (taken < parents.size() && depths[taken] < depth))
+      r.failed = true;
+
+    unsigned int grid_cells = r.get<unsigned int>();
+    int layers = 1 + (robot_grids == NULL ? 0 : robot_grids->size());
+    if (grid != NULL && grid_cells == layers * board->getRows() * cols) {
+      for (int l = 0; l < layers; ++l) {
+        std::vector<std::vector<int> > &g = (l == 0) ? *grid : (*robot_grids)[l-1];
+        for (int row = 0; row < board->getRows(); ++row) {
+          for (int col = 0; col < cols; ++col)
+            g[row][col] = r.get<int>();
+        }
+      }
+    }
+    if (r.failed) {
+      error = resume_file + " is corrupt";
+      return false;
+    }
+    resume_bytes += sizeof(length) + length + sizeof(end);
+    records++;
+  }
+  if (records == 0) {
+    error = resume_file + " has no complete checkpoints";
+    return false;
+  }
+
+  // What's still on the queue, with the path to each state traced back
+  queue.clear();
+  for (unsigned long long n = taken; n < parents.size(); ++n) {
+    BoardState q(board);
+    for (int j = 0; j < num_robots; ++j) {
+      int cell = cells[n * num_robots + j];
+      q.bots[j] = Position(cell / cols + 1, cell % cols + 1);
+    }
+    std::vector<std::pair<char, std::string> > path(depths[n]);
+    for (unsigned long long at = n; moves[at] != NO_MOVE; at = parents[at])
+      path[depths[at] - 1] = std::make_pair(board->getRobot(moves[at] / 4), std::string(DIRECTIONS[moves[at] % 4]));
+    q.moves.push_back(path);
+    if (moves[n] != NO_MOVE) {
+      q.last_bot = moves[n] / 4;
+      q.last_dir = DIRECTIONS[moves[n] % 4];
+      int from = cells[parents[n] * num_robots + q.last_bot];
+      q.last_from = Position(from / cols + 1, from % cols + 1);
+    }
+    queue.push_back(q);
+  }
+  queued_count = parents.size();
+  taken_count = taken;
+  return true;
+}
@@ -0,0 +1,101 @@
+#include <deque>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "board.h"
+#include "boardstate.h"
+#include "visited.h"
+#include "search.h"
+
+#ifndef _checkpoint_h_
+#define _checkpoint_h_
+
+// ==================================================================
+// ==================================================================
+// Snapshots of a breadth first search, so a long search can be stopped and
+// picked up again later with -resume.
+//
+// A snapshot file starts with a header recording the version, the kind of
+// search and its options, and a signature of the board. After that come
+// records, written at the start of a depth and once more if the search is
+// stopped by its time or memory limit. Every state put on the queue is
+// numbered in order and written once, in the first record after it was
+// queued: the number of the state it was reached from, the move, and the
+// robot positions. Since the queue is first in, first out, what's on it is
+// always the states from the number of states taken off it so far on, so
+// that count is all a record needs to say for the queue; the paths and last
+// moves are traced back through the numbers on resuming. Each record also
+// has the accessibility grids if there are any, and the number of states
+// explored. Records are only ever appended, and a record that was cut off
+// part way through is ignored when reading.
+
+// the kinds of search a snapshot can be of
+const int SNAPSHOT_PATH = 0;
+const int SNAPSHOT_ALL_PATHS = 1;
+const int SNAPSHOT_ACCESSIBILITY = 2;
+const int SNAPSHOT_ROBOT_ACCESSIBILITY = 3;
+
+class Checkpoint {
+public:
+  // Uses options.checkpoint_file, options.checkpoint_interval and
+  // options.resume_file. If neither file is given, everything is a no-op.
+  Checkpoint(const Board *board, const SearchOptions &options, int kind);
+
+  bool resuming() const { return !resume_file.empty(); }
+
+  // Reads the snapshot being resumed, adding its visited states to visited
+  // and its last queue to queue, and filling in grid and robot_grids (if not
+  // NULL) and explored. Returns false (with the reason in error) if the
+  // snapshot can't be read or is for a different board or search.
+  bool resume(VisitedSet *visited, std::deque<BoardState> &queue,
+              std::vector<std::vector<int> > *grid,
+              std::vector<std::vector<std::vector<int> > > *robot_grids,
+              long &explored, std::string &error);
+
+  // To be called for each state put on the queue, and each one taken off
+  void queued(const BoardState &s) {
+    if (active)
+      addState(s);
+  }
+  void taken() { taken_count++; }
+
+  // To be called when the first state of a new depth is about to come off
+  // the queue. Writes a record if it's been long enough since the last one.
+  void startDepth(int depth, const std::vector<std::vector<int> > *grid,
+                  const std::vector<std::vector<std::vector<int> > > *robot_grids, long explored);
+  // To be called if the search is stopped by a limit. Writes a record
+  // whatever the time since the last one.
+  void stopped(int depth, const std::vector<std::vector<int> > *grid,
+               const std::vector<std::vector<std::vector<int> > > *robot_grids, long explored);
+
+private:
+  void addState(const BoardState &s);
+  void write(int depth, const std::vector<std::vector<int> > *grid,
+             const std::vector<std::vector<std::vector<int> > > *robot_grids, long explored);
+  unsigned long long signature() const;
+
+  const Board *board;
+  int kind;
+  int max_moves;
+  bool prune;
+
+  // where records are written (empty for none)
+  std::string checkpoint_file;
+  bool active;
+  double interval;
+  std::chrono::steady_clock::time_point last_write;
+  // the snapshot being resumed (empty for none), and how much of it is good
+  std::string resume_file;
+  long resume_bytes;
+  // nothing has been written to checkpoint_file yet
+  bool first_write;
+
+  // how many states have been put on and taken off the queue
+  unsigned long long queued_count;
+  unsigned long long taken_count;
+  // the states queued since the last record, as written in the file
+  std::string pending;
+};
+
+#endif
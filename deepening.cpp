@@ -0,0 +1,212 @@
+#include <algorithm>
+
+#include "deepening.h"
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the TranspositionTable class
+
+// the table gets at least this many slots, however little memory is left
+static const long MIN_TABLE_SLOTS = 1024;
+
+TranspositionTable::TranspositionTable(long num_slots) : slots(num_slots) {}
+
+bool TranspositionTable::seen(PackedState key, int depth, int iteration) {
+  // mix the bits up a bit, since neighbouring states only differ in one byte
+  PackedState h = key * 0x9E3779B97F4A7C15ULL;
+  Slot &slot = slots[(h >> 17) % slots.size()];
+  if (slot.iteration == iteration && slot.key == key && slot.depth <= depth) {
+    return true;
+  }
+  slot.key = key;
+  slot.depth = depth;
+  slot.iteration = iteration;
+  return false;
+}
+
+
+// ==================================================================
+// ==================================================================
+// The depth first search
+
+// Everything the search needs to carry along
+class Deepening {
+public:
+  const StatePacker *packer;
+  const VisitedSet *visited;
+  TranspositionTable *table;
+  SearchBudget *budget;
+  SearchResult *result;
+  int pruning;
+  // the cap or upper bound the moves left for PRUNE_BLOCKERS count against
+  int most_moves;
+  BlockerPruner *blockers;
+  int max_moves;
+  // the number of moves paths are followed to in this iteration
+  int bound;
+  int iteration;
+  // set if some path was cut short by the bound, i.e. going deeper could
+  // still find something
+  bool cutoff;
+  bool done;
+
+  std::deque<BoardState> frontier;
+  // the frontier state the current path starts from
+  long root;
+  // the successors of each state on the current path, and which of them is
+  // being followed
+  class Frame {
+  public:
+    std::vector<BoardState> next;
+    int index;
+    int depth;
+  };
+  std::vector<Frame> stack;
+};
+
+// What came of looking at a state
+enum Visit { VISIT_SKIPPED, VISIT_EXPANDED, VISIT_WON, VISIT_STOPPED };
+
+// Looks at a state reached in depth moves, putting its successors on the
+// stack if they are worth following
+static Visit visit(Deepening &d, BoardState &state, int depth) {
+  // frontier states can be one move deeper than the first bound
+  if (depth > d.bound) {
+    d.cutoff = true;
+    return VISIT_SKIPPED;
+  }
+  if (state.wins()) {
+    d.result->solutions.push_back(state);
+    return VISIT_WON;
+  }
+  if (depth == d.bound) {
+    d.cutoff = true;
+    return VISIT_SKIPPED;
+  }
+  if (d.budget->exceeded()) {
+    return VISIT_STOPPED;
+  }
+  // The breadth first search got here in fewer moves, so this can't be on a
+  // shortest path.
+  int first = d.visited->depth(state);
+  if (first != -1 && first < depth) {
+    return VISIT_SKIPPED;
+  }
+  if (d.table != NULL && d.table->seen(d.packer->pack(state), depth, d.iteration)) {
+    return VISIT_SKIPPED;
+  }
+  d.result->states_explored++;
+  d.stack.push_back(Deepening::Frame());
+  d.stack.back().next = state.get_adjacent(d.pruning, moves_left(d.most_moves, depth), d.blockers);
+  d.stack.back().index = 0;
+  d.stack.back().depth = depth;
+  return VISIT_EXPANDED;
+}
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the DeepeningSearch class
+
+DeepeningSearch::DeepeningSearch(Board *board, std::deque<BoardState> &frontier,
+                                 const VisitedSet *visited, const SearchOptions &options,
+                                 SearchBudget &budget, SearchResult &result) {
+  d = new Deepening;
+  d->frontier.swap(frontier);
+  d->visited = visited;
+  d->budget = &budget;
+  d->result = &result;
+  // Which move gets pruned by reordering depends on the path taken to a
+  // state, and the transposition table only remembers the state, so only the
+  // moves that can never help are dropped here. Which robots are worth
+  // moving only depends on the state and how many moves are left.
+  d->pruning = options.prune ? PRUNE_REVERSE | PRUNE_BLOCKERS : PRUNE_NONE;
+  d->max_moves = options.max_moves;
+  d->most_moves = options.max_moves;
+  if (d->most_moves == -1 && options.prune)
+    d->most_moves = helper_robot_bound(board);
+  d->blockers = newBlockerPruner(board, d->pruning);
+
+  // Whatever memory is left goes to the transposition table
+  d->table = NULL;
+  d->packer = NULL;
+  if (fitsPacked(board)) {
+    long slots = std::max(budget.memoryLeft() / TranspositionTable::slotBytes(), MIN_TABLE_SLOTS);
+    d->table = new TranspositionTable(slots);
+    d->packer = new StatePacker(board, true);
+  }
+  // The table is all the memory this part needs, so from here on only the
+  // time limit applies.
+  budget.setMemoryLimit(-1);
+
+  int start = -1;
+  for (long i = 0; i < d->frontier.size(); ++i) {
+    int depth = d->frontier[i].moves[0].size();
+    if (start == -1 || depth < start)
+      start = depth;
+  }
+  result.status = SEARCH_COMPLETE;
+  d->bound = start - 1;
+  d->done = !startIteration();
+}
+
+DeepeningSearch::~DeepeningSearch() {
+  delete d->table;
+  delete d->packer;
+  delete d->blockers;
+  delete d;
+}
+
+bool DeepeningSearch::startIteration() {
+  d->bound++;
+  if (d->frontier.empty() || (d->max_moves != -1 && d->bound > d->max_moves))
+    return false;
+  d->iteration = d->bound;
+  d->cutoff = false;
+  d->root = 0;
+  return true;
+}
+
+bool DeepeningSearch::step(long max_states) {
+  long expanded = 0;
+  while (!d->done && expanded < max_states) {
+    Visit v;
+    if (d->stack.empty()) {
+      if (d->root == d->frontier.size()) {
+        // Nothing with bound or fewer moves
+        d->result->lower_bound = d->bound + 1;
+        // Every path ran into a dead end before the bound, so going deeper
+        // won't find anything either.
+        d->done = !d->cutoff || !startIteration();
+        continue;
+      }
+      BoardState state(d->frontier[d->root++]);
+      v = visit(*d, state, state.moves[0].size());
+    }
+    else {
+      Deepening::Frame &top = d->stack.back();
+      if (top.index == top.next.size()) {
+        d->stack.pop_back();
+        continue;
+      }
+      // (visiting it can add to the stack, so it can't stay in the frame)
+      BoardState state(top.next[top.index++]);
+      v = visit(*d, state, top.depth + 1);
+    }
+    if (v == VISIT_EXPANDED) {
+      expanded++;
+    }
+    else if (v == VISIT_WON) {
+      d->result->lower_bound = d->result->solutions[0].moves[0].size();
+      d->done = true;
+    }
+    else if (v == VISIT_STOPPED) {
+      d->result->status = d->budget->status;
+      d->done = true;
+    }
+  }
+  if (d->done)
+    d->stack.clear();
+  return d->done;
+}
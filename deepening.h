@@ -0,0 +1,81 @@
+#include <vector>
+#include <deque>
+
+#include "board.h"
+#include "boardstate.h"
+#include "visited.h"
+#include "search.h"
+
+#ifndef _deepening_h_
+#define _deepening_h_
+
+// ==================================================================
+// ==================================================================
+// A fixed size table of packed states remembering how many moves it took to
+// get to each one during the current iteration of the deepening search. When
+// two states land in the same slot the newer one simply replaces the older
+// one, so the table never grows; forgetting a state only costs the time to
+// search it again.
+
+class TranspositionTable {
+public:
+  TranspositionTable(long num_slots);
+
+  // Returns true if the state was already reached in this iteration in depth
+  // moves or fewer, in which case there's no need to search it again.
+  // Otherwise records it and returns false.
+  bool seen(PackedState key, int depth, int iteration);
+
+  long bytes() const { return slots.size() * sizeof(Slot); }
+  static long slotBytes() { return sizeof(Slot); }
+
+private:
+  class Slot {
+  public:
+    Slot() : key(0), depth(0), iteration(-1) {}
+    PackedState key;
+    int depth;
+    int iteration;
+  };
+  std::vector<Slot> slots;
+};
+
+
+// ==================================================================
+// ==================================================================
+// Iterative deepening search carrying on where a breadth first search left
+// off. frontier holds the states still on the breadth first queue, and
+// visited the states it had seen; any state reached in more moves than the
+// breadth first search needed is skipped. The solution, the lower bound and
+// the status go in result, and the memory that's left in the budget is used
+// for the transposition table.
+//
+// The search is run a few states at a time. The paths being followed are
+// kept on a stack of their own rather than recursing, so it can stop after
+// any state and pick up from there on the next call to step. The frontier is
+// taken over (swapped out of the deque it's given), and visited, budget and
+// result have to outlast the search.
+
+class Deepening;
+
+class DeepeningSearch {
+public:
+  DeepeningSearch(Board *board, std::deque<BoardState> &frontier, const VisitedSet *visited,
+                  const SearchOptions &options, SearchBudget &budget, SearchResult &result);
+  ~DeepeningSearch();
+
+  // Expands up to max_states more states. Returns true once the search is
+  // over.
+  bool step(long max_states);
+
+private:
+  DeepeningSearch(const DeepeningSearch &);
+  DeepeningSearch &operator=(const DeepeningSearch &);
+
+  // Sets up the next iteration, or returns false if there shouldn't be one
+  bool startIteration();
+
+  Deepening *d;
+};
+
+#endif
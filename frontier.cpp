@@ -0,0 +1,628 @@
+#include <algorithm>
+#include <atomic>
+
+#include "frontier.h"
+
+
+// how many states are expanded before their successors are looked up
+static const int CHUNK_STATES = 64;
+
+// the move stored for the starting state
+static const unsigned char NO_MOVE = 255;
+
+
+// ==================================================================
+// ==================================================================
+// The two kinds of key the search keeps states in: a PackedState, or the
+// WideKey the board needs when its states don't fit in one (see visited.h)
+
+static int get_cell(PackedState key, int offset, int bits) {
+  return (key >> offset) & ((1ULL << bits) - 1);
+}
+
+template <int WORDS>
+static int get_cell(const WideKey<WORDS> &key, int offset, int bits) {
+  return key.get(offset, bits);
+}
+
+static void set_cell(PackedState &key, int offset, int cell, int bits) {
+  key = (key & ~(((1ULL << bits) - 1) << offset)) | ((PackedState)cell << offset);
+}
+
+template <int WORDS>
+static void set_cell(WideKey<WORDS> &key, int offset, int cell, int bits) {
+  key.replace(offset, cell, bits);
+}
+
+static unsigned long long hash_key(PackedState key) {
+  // neighbouring states differ in a single field, so mix the bits first
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  return key;
+}
+
+template <int WORDS>
+static unsigned long long hash_key(const WideKey<WORDS> &key) {
+  return WideKeyHash<WORDS>()(key);
+}
+
+// All bits set. No state packs to this, since no two robots share a cell
+// (and a lone robot leaves the bits past its own clear).
+static void make_empty(PackedState &key) {
+  key = ~0ULL;
+}
+
+template <int WORDS>
+static void make_empty(WideKey<WORDS> &key) {
+  for (int i = 0; i < WORDS; ++i)
+    key.words[i] = ~0ULL;
+}
+
+
+// ==================================================================
+// ==================================================================
+// The visited table: packed states in one flat array, found by linear
+// probing from their hash. It is kept at most half full.
+
+template <class Key>
+class LevelTable {
+public:
+  LevelTable() : count(0) {
+    make_empty(empty);
+    slots.assign(1024, empty);
+  }
+
+  // Makes room for this many more states, so the slots prefetched for them
+  // stay where they are
+  void reserve(long more) {
+    if ((count + more) * 2 <= (long)slots.size())
+      return;
+    long size = slots.size();
+    while ((count + more) * 2 > size)
+      size *= 2;
+    std::vector<Key> old(size, empty);
+    old.swap(slots);
+    for (long i = 0; i < old.size(); ++i) {
+      if (!(old[i] == empty))
+        slots[find(old[i])] = old[i];
+    }
+  }
+
+  void prefetch(const Key &key) const {
+    __builtin_prefetch(&slots[hash_key(key) & (slots.size() - 1)]);
+  }
+
+  // Returns true if the state wasn't there before
+  bool insert(const Key &key) {
+    long i = find(key);
+    if (slots[i] == key)
+      return false;
+    slots[i] = key;
+    count++;
+    return true;
+  }
+
+  long bytes() const { return slots.size() * sizeof(Key); }
+
+private:
+  // the slot holding key, or the empty one it would go in
+  long find(const Key &key) const {
+    long mask = slots.size() - 1;
+    long i = hash_key(key) & mask;
+    while (!(slots[i] == empty) && !(slots[i] == key))
+      i = (i + 1) & mask;
+    return i;
+  }
+
+  std::vector<Key> slots;
+  Key empty;
+  long count;
+};
+
+
+// ==================================================================
+// ==================================================================
+// The search
+
+// The states of the level being expanded or filled. from is the cell the
+// robot that moved last started on.
+template <class Key>
+class LevelBuffer {
+public:
+  void clear() { keys.clear(); from.clear(); }
+  long bytesPerState() const { return sizeof(Key) + sizeof(int); }
+
+  std::vector<Key> keys;
+  std::vector<int> from;
+};
+
+// How each state of a level was reached: the index of its parent in the
+// level before, and the move (robot * 4 + direction)
+class LevelTrail {
+public:
+  std::vector<unsigned int> parents;
+  std::vector<unsigned char> moves;
+};
+
+// A successor waiting to be looked up
+template <class Key>
+class Successor {
+public:
+  Key key;
+  Key visited_key;
+  unsigned int parent;
+  unsigned char move;
+  int from;
+};
+
+// Everything the search needs to carry along
+template <class Key>
+class LevelSearch {
+public:
+  LevelSearch(const Board *b, const SearchOptions &options, bool symmetric = true)
+    : board(b), packer(b, symmetric), blockers(NULL), budget(options), cancelled(false) {}
+  ~LevelSearch() { delete blockers; }
+
+  const Board *board;
+  StatePacker packer;
+  int num_robots;
+  int bits;
+  int cols;
+  int pruning;
+  int goal_cell;
+  int goal_robot;
+  // where each cell slides to in each direction with nothing but the walls
+  // in the way, and the row and column of each cell
+  std::vector<int> stops;
+  std::vector<int> rows_of;
+  std::vector<int> cols_of;
+  // which robots are worth moving, and how far from the goal they are (NULL
+  // unless PRUNE_BLOCKERS is used)
+  BlockerPruner *blockers;
+
+  int max_moves;
+  // what the moves left for PRUNE_BLOCKERS are counted against
+  int bound;
+  int upper_bound;
+  SearchBudget budget;
+  SearchResult result;
+  bool done;
+  std::atomic<bool> cancelled;
+
+  LevelTable<Key> visited;
+  LevelBuffer<Key> current;
+  LevelBuffer<Key> next;
+  std::vector<LevelTrail> trails;
+  std::vector<Successor<Key> > successors;
+  // the depth of the current level, and how much of it has been expanded
+  int depth;
+  long position;
+};
+
+template <class Key>
+static void unpack(const LevelSearch<Key> &s, const Key &key, int *cells) {
+  for (int i = 0; i < s.num_robots; ++i)
+    cells[i] = get_cell(key, s.bits * i, s.bits);
+}
+
+// Where the robot on cell "at" ends up moving in direction d, with the robots
+// on cells. As BoardState::moveRobot, the walls give how far it can go and
+// any robot in the way cuts that short.
+template <class Key>
+static int slide(const LevelSearch<Key> &s, const int *cells, int at, int d) {
+  int stop = s.stops[at * 4 + d];
+  int row = s.rows_of[at];
+  int col = s.cols_of[at];
+  int stop_row = s.rows_of[stop];
+  int stop_col = s.cols_of[stop];
+  for (int i = 0; i < s.num_robots; ++i) {
+    int r = s.rows_of[cells[i]];
+    int c = s.cols_of[cells[i]];
+    if (d == 0 && c == col && r < row && r >= stop_row)
+      stop_row = r + 1;
+    else if (d == 1 && r == row && c > col && c <= stop_col)
+      stop_col = c - 1;
+    else if (d == 2 && c == col && r > row && r <= stop_row)
+      stop_row = r - 1;
+    else if (d == 3 && r == row && c < col && c >= stop_col)
+      stop_col = c + 1;
+  }
+  return stop_row * s.cols + stop_col;
+}
+
+// As BoardState::commutes_with_last
+template <class Key>
+static bool commutes_with_last(const LevelSearch<Key> &s, const int *cells, int bot, int d, int to,
+                               int last_bot, int last_d, int last_from) {
+  int p[MAX_ROBOTS];
+  std::copy(cells, cells + s.num_robots, p);
+  p[last_bot] = last_from;
+  if (slide(s, p, cells[bot], d) != to)
+    return false;
+  p[bot] = to;
+  return slide(s, p, last_from, last_d) == cells[last_bot];
+}
+
+// Adds the successors of a state to out, in the same order and with the same
+// pruning as BoardState::get_adjacent
+template <class Key>
+static void expand(LevelSearch<Key> &s, const Key &key, unsigned int index, unsigned char move,
+                   int from, int budget, std::vector<Successor<Key> > &out) {
+  int cells[MAX_ROBOTS];
+  unpack(s, key, cells);
+  int last_bot = (move == NO_MOVE) ? -1 : move / 4;
+  int last_d = move % 4;
+  bool bounded = (s.pruning & PRUNE_BLOCKERS) && budget != -1 && s.blockers != NULL;
+  unsigned int relevant = ~0U;
+  if (bounded)
+    relevant = s.blockers->relevant(cells, budget);
+  bool skip_useless = s.pruning & (PRUNE_REVERSE | PRUNE_COMMUTING);
+  for (int i = 0; i < s.num_robots; ++i) {
+    if (!(relevant & (1U << i)))
+      continue;
+    for (int d = 0; d < 4; ++d) {
+      if (skip_useless && i == last_bot && (d == last_d || d == (last_d + 2) % 4))
+        continue;
+      int to = slide(s, cells, cells[i], d);
+      if (skip_useless && to == cells[i])
+        continue;
+      if ((s.pruning & PRUNE_COMMUTING) && last_bot != -1 && i != last_bot && cells[i] < from &&
+          commutes_with_last(s, cells, i, d, to, last_bot, last_d, from))
+        continue;
+      int moved = cells[i];
+      cells[i] = to;
+      if (bounded) {
+        // the goal has to be reachable in the moves left after this one
+        int needed = s.blockers->movesNeeded(cells);
+        if (needed == -1 || needed >= budget) {
+          cells[i] = moved;
+          continue;
+        }
+      }
+      Successor<Key> next;
+      next.key = key;
+      set_cell(next.key, s.bits * i, to, s.bits);
+      s.packer.pack(cells, next.visited_key);
+      cells[i] = moved;
+      next.parent = index;
+      next.move = i * 4 + d;
+      next.from = moved;
+      out.push_back(next);
+    }
+  }
+}
+
+template <class Key>
+static bool wins(const LevelSearch<Key> &s, const Successor<Key> &next) {
+  int bot = next.move / 4;
+  // only the robot that just moved can have got onto the goal
+  if (s.goal_robot != -1 && bot != s.goal_robot)
+    return false;
+  return get_cell(next.key, s.bits * bot, s.bits) == s.goal_cell;
+}
+
+// Follows the parents back from the winning state to build the solution
+template <class Key>
+static BoardState trace(const LevelSearch<Key> &s, const std::vector<LevelTrail> &trails,
+                        const Successor<Key> &winner, unsigned int index) {
+  std::vector<std::pair<char, std::string> > path(trails.size() - 1);
+  for (int depth = trails.size() - 1; depth > 0; --depth) {
+    unsigned char move = trails[depth].moves[index];
+    path[depth - 1] = std::make_pair(s.board->getRobot(move / 4), std::string(DIRECTIONS[move % 4]));
+    index = trails[depth].parents[index];
+  }
+  int cells[MAX_ROBOTS];
+  unpack(s, winner.key, cells);
+  std::vector<Position> bots(s.num_robots);
+  for (int i = 0; i < s.num_robots; ++i)
+    bots[i] = Position(s.rows_of[cells[i]] + 1, s.cols_of[cells[i]] + 1);
+  BoardState state(bots, s.board, std::vector<std::vector<std::pair<char, std::string> > >(1, path));
+  state.last_bot = winner.move / 4;
+  state.last_dir = DIRECTIONS[winner.move % 4];
+  state.last_from = Position(s.rows_of[winner.from] + 1, s.cols_of[winner.from] + 1);
+  return state;
+}
+
+// Fills in the board's tables
+template <class Key>
+static void setup(LevelSearch<Key> &s, const Board *board, const SearchOptions &options) {
+  s.num_robots = board->numRobots();
+  s.bits = cellBits(board);
+  s.cols = board->getCols();
+  s.pruning = options.prune ? PRUNE_ALL : PRUNE_NONE;
+  s.goal_cell = (board->getGoal().row - 1) * s.cols + (board->getGoal().col - 1);
+  s.goal_robot = board->getGoalRobot();
+  int num_cells = board->getRows() * s.cols;
+  for (int cell = 0; cell < num_cells; ++cell) {
+    Position p(cell / s.cols + 1, cell % s.cols + 1);
+    s.rows_of.push_back(p.row - 1);
+    s.cols_of.push_back(p.col - 1);
+    for (int d = 0; d < 4; ++d) {
+      Position to = board->slideTo(p, d);
+      s.stops.push_back((to.row - 1) * s.cols + (to.col - 1));
+    }
+  }
+}
+
+// ==================================================================
+// ==================================================================
+// Implementation of the LevelPathFinder class
+
+template <class Key>
+LevelPathFinder<Key>::LevelPathFinder(const Board *board, const SearchOptions &options) {
+  search = new LevelSearch<Key>(board, options);
+  LevelSearch<Key> &s = *search;
+  setup(s, board, options);
+  s.blockers = newBlockerPruner(board, s.pruning);
+  s.max_moves = options.max_moves;
+  // (the closer bound is only worth the time it takes when it's used)
+  s.upper_bound = options.prune ? helper_robot_bound(board) : single_robot_bound(board);
+  s.bound = s.max_moves;
+  if (s.bound == -1 && options.prune)
+    s.bound = s.upper_bound;
+  s.depth = 0;
+  s.position = 0;
+  s.done = false;
+
+  BoardState initial(board);
+  if (initial.wins()) {
+    initial.moves.push_back(std::vector<std::pair<char, std::string> >());
+    s.result.solutions.push_back(initial);
+    s.upper_bound = 0;
+    s.done = true;
+    return;
+  }
+  int start[MAX_ROBOTS];
+  Key start_key = Key();
+  for (int i = 0; i < s.num_robots; ++i) {
+    start[i] = (initial.bots[i].row - 1) * s.cols + (initial.bots[i].col - 1);
+    set_cell(start_key, s.bits * i, start[i], s.bits);
+  }
+  Key visited_key;
+  s.packer.pack(start, visited_key);
+  s.visited.insert(visited_key);
+  s.current.keys.push_back(start_key);
+  s.current.from.push_back(0);
+  s.trails.push_back(LevelTrail());
+  s.trails[0].parents.push_back(0);
+  s.trails[0].moves.push_back(NO_MOVE);
+  s.budget.use(s.current.bytesPerState() + sizeof(unsigned int) + 1);
+  s.budget.setTableBytes(s.visited.bytes());
+  s.successors.reserve(CHUNK_STATES * 4 * s.num_robots);
+}
+
+template <class Key>
+LevelPathFinder<Key>::~LevelPathFinder() {
+  delete search;
+}
+
+template <class Key>
+void LevelPathFinder<Key>::cancel() {
+  search->cancelled = true;
+}
+
+template <class Key>
+bool LevelPathFinder<Key>::done() const {
+  return search->done;
+}
+
+template <class Key>
+const SearchResult &LevelPathFinder<Key>::result() const {
+  return search->result;
+}
+
+template <class Key>
+int LevelPathFinder<Key>::upperBound() const {
+  return search->upper_bound;
+}
+
+template <class Key>
+bool LevelPathFinder<Key>::step(long max_states) {
+  LevelSearch<Key> &s = *search;
+  SearchResult &result = s.result;
+  long expanded = 0;
+  while (!s.done && expanded < max_states) {
+    if (s.position == 0) {
+      if (s.current.keys.empty()) {
+        // Ran out of states, so there is no solution within the cap (this
+        // level is the first with none, one past the last one expanded)
+        result.lower_bound = (s.max_moves == -1) ? s.depth : s.max_moves + 1;
+        s.done = true;
+        break;
+      }
+      // Every state with this many moves was checked as it was made
+      result.lower_bound = s.depth + 1;
+      // Stop adding states after we reach max moves
+      if (s.max_moves != -1 && s.depth >= s.max_moves) {
+        result.lower_bound = s.max_moves + 1;
+        s.done = true;
+        break;
+      }
+      s.trails.push_back(LevelTrail());
+    }
+    if (s.cancelled) {
+      result.status = SEARCH_CANCELLED;
+      s.done = true;
+      break;
+    }
+
+    LevelTrail &trail = s.trails.back();
+    const LevelTrail &came = s.trails[s.depth];
+    long last = std::min(s.position + std::min((long)CHUNK_STATES, max_states - expanded),
+                         (long)s.current.keys.size());
+    s.successors.clear();
+    for (; s.position < last; ++s.position) {
+      if (s.budget.exceeded())
+        break;
+      result.states_explored++;
+      expanded++;
+      expand(s, s.current.keys[s.position], s.position, came.moves[s.position],
+             s.current.from[s.position], moves_left(s.bound, s.depth), s.successors);
+    }
+    // every slot is fetched before any is needed
+    s.visited.reserve(s.successors.size());
+    for (int i = 0; i < s.successors.size(); ++i)
+      s.visited.prefetch(s.successors[i].visited_key);
+    for (int i = 0; i < s.successors.size(); ++i) {
+      if (!s.visited.insert(s.successors[i].visited_key))
+        continue;
+      s.next.keys.push_back(s.successors[i].key);
+      s.next.from.push_back(s.successors[i].from);
+      trail.parents.push_back(s.successors[i].parent);
+      trail.moves.push_back(s.successors[i].move);
+      s.budget.use(s.next.bytesPerState() + sizeof(unsigned int) + 1);
+      if (wins(s, s.successors[i])) {
+        result.lower_bound = s.depth + 1;
+        s.upper_bound = s.depth + 1;
+        result.solutions.push_back(trace(s, s.trails, s.successors[i], s.next.keys.size() - 1));
+        s.done = true;
+        return true;
+      }
+    }
+    s.budget.setTableBytes(s.visited.bytes());
+    if (s.budget.status != SEARCH_COMPLETE) {
+      result.status = s.budget.status;
+      s.done = true;
+      break;
+    }
+    if (s.position == s.current.keys.size()) {
+      // the finished level's states go, but not how they were reached
+      s.budget.release(s.current.keys.size() * s.current.bytesPerState());
+      s.current.clear();
+      std::swap(s.current, s.next);
+      s.depth++;
+      s.position = 0;
+    }
+  }
+  return s.done;
+}
+
+template class LevelPathFinder<PackedState>;
+template class LevelPathFinder<WideKey<2> >;
+template class LevelPathFinder<WideKey<4> >;
+template class LevelPathFinder<WideKey<7> >;
+template class LevelPathFinder<WideKey<MAX_KEY_WORDS> >;
+
+PathFinder *newLevelPathFinder(const Board *board, const SearchOptions &options) {
+  if (fitsPacked(board))
+    return new LevelPathFinder<PackedState>(board, options);
+  switch (keyWords(board)) {
+  case 2: return new LevelPathFinder<WideKey<2> >(board, options);
+  case 4: return new LevelPathFinder<WideKey<4> >(board, options);
+  case 7: return new LevelPathFinder<WideKey<7> >(board, options);
+  default: return new LevelPathFinder<WideKey<MAX_KEY_WORDS> >(board, options);
+  }
+}
+
+
+// ==================================================================
+// ==================================================================
+// Accessibility over the packed states
+
+template <class Key>
+static std::vector<std::vector<int> > accessibility(const Board *board, const SearchOptions &options,
+                                                    SearchResult *result,
+                                                    std::vector<std::vector<std::vector<int> > > *robot_grids) {
+  // robots can only stand in for each other when nobody asks which went where
+  LevelSearch<Key> s(board, options, robot_grids == NULL);
+  setup(s, board, options);
+  // (as in bf_accessibility, how many moves are left isn't known)
+  s.pruning &= ~PRUNE_BLOCKERS;
+  int max_moves = options.max_moves;
+  SearchResult stats;
+
+  int rows = board->getRows();
+  std::vector<std::vector<int> > grid(rows, std::vector<int>(s.cols, -1));
+  if (robot_grids != NULL)
+    robot_grids->assign(s.num_robots, grid);
+  int start[MAX_ROBOTS];
+  Key start_key = Key();
+  for (int i = 0; i < s.num_robots; ++i) {
+    Position pos = board->getRobotPosition(i);
+    start[i] = (pos.row - 1) * s.cols + (pos.col - 1);
+    set_cell(start_key, s.bits * i, start[i], s.bits);
+    grid[pos.row-1][pos.col-1] = 0;
+    if (robot_grids != NULL)
+      (*robot_grids)[i][pos.row-1][pos.col-1] = 0;
+  }
+
+  Key visited_key;
+  s.packer.pack(start, visited_key);
+  s.visited.insert(visited_key);
+  s.current.keys.push_back(start_key);
+  s.current.from.push_back(0);
+  // the move that reached each state of the current and next levels
+  std::vector<unsigned char> came(1, NO_MOVE);
+  std::vector<unsigned char> going;
+  long state_bytes = s.current.bytesPerState() + 1;
+  s.budget.use(state_bytes);
+  s.budget.setTableBytes(s.visited.bytes());
+
+  for (int depth = 0; !s.current.keys.empty() && s.budget.status == SEARCH_COMPLETE; ++depth) {
+    for (long position = 0; position < s.current.keys.size(); ) {
+      long last = std::min(position + CHUNK_STATES, (long)s.current.keys.size());
+      s.successors.clear();
+      for (; position < last; ++position) {
+        if (s.budget.exceeded())
+          break;
+        stats.states_explored++;
+        stats.lower_bound = depth;
+        // Stop adding states after we reach max moves
+        if (max_moves == -1 || depth < max_moves)
+          expand(s, s.current.keys[position], position, came[position], s.current.from[position],
+                 -1, s.successors);
+      }
+      s.visited.reserve(s.successors.size());
+      for (int i = 0; i < s.successors.size(); ++i)
+        s.visited.prefetch(s.successors[i].visited_key);
+      for (int i = 0; i < s.successors.size(); ++i) {
+        const Successor<Key> &next = s.successors[i];
+        if (!s.visited.insert(next.visited_key))
+          continue;
+        s.next.keys.push_back(next.key);
+        s.next.from.push_back(next.from);
+        going.push_back(next.move);
+        s.budget.use(state_bytes);
+        // Only the robot that moved is anywhere new, since the cells of the
+        // others were marked when the state before this one was added (and
+        // the levels come in order, so the first time is the fewest moves)
+        int bot = next.move / 4;
+        int cell = get_cell(next.key, s.bits * bot, s.bits);
+        int &g = grid[s.rows_of[cell]][s.cols_of[cell]];
+        if (g == -1)
+          g = depth + 1;
+        if (robot_grids != NULL) {
+          int &r = (*robot_grids)[bot][s.rows_of[cell]][s.cols_of[cell]];
+          if (r == -1)
+            r = depth + 1;
+        }
+      }
+      s.budget.setTableBytes(s.visited.bytes());
+      if (s.budget.status != SEARCH_COMPLETE)
+        break;
+    }
+    s.budget.release(s.current.keys.size() * state_bytes);
+    s.current.clear();
+    std::swap(s.current, s.next);
+    came.clear();
+    came.swap(going);
+  }
+  stats.status = s.budget.status;
+  if (result != NULL)
+    *result = stats;
+  return grid;
+}
+
+std::vector<std::vector<int> > level_accessibility(const Board *board, const SearchOptions &options,
+                                                   SearchResult *result,
+                                                   std::vector<std::vector<std::vector<int> > > *robot_grids) {
+  if (fitsPacked(board))
+    return accessibility<PackedState>(board, options, result, robot_grids);
+  switch (keyWords(board)) {
+  case 2: return accessibility<WideKey<2> >(board, options, result, robot_grids);
+  case 4: return accessibility<WideKey<4> >(board, options, result, robot_grids);
+  case 7: return accessibility<WideKey<7> >(board, options, result, robot_grids);
+  default: return accessibility<WideKey<MAX_KEY_WORDS> >(board, options, result, robot_grids);
+  }
+}
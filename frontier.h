@@ -0,0 +1,75 @@
+#include <vector>
+
+#include "board.h"
+#include "visited.h"
+#include "search.h"
+
+#ifndef _frontier_h_
+#define _frontier_h_
+
+// ==================================================================
+// ==================================================================
+// Breadth first search for a single shortest path that keeps its states as
+// packed keys in flat arrays rather than as BoardStates.
+//
+// The search goes one level (number of moves) at a time. The level being
+// expanded and the level being filled are two buffers of packed states (the
+// robots' actual cells) that swap roles at the end of each level, so the
+// depth is just the number of swaps so far. For every level the search also
+// keeps, in arrays of their own, the index of each state's parent in the
+// level before and the move that got there. That's all it takes to trace the
+// path back once the goal is reached, so no state ever carries its path.
+//
+// Successors are made a chunk of states at a time. The visited table (open
+// addressing on the packed state, with interchangeable robots sorted like
+// the StatePacker does) has the slot of every successor in the chunk
+// prefetched before any of them is looked up, so the cache misses overlap
+// instead of coming one after another. They are still added in the order
+// they were made, so the search goes through states in exactly the same
+// order as bf_path_finder and finds the same path.
+//
+// The keys are PackedStates on boards where fitsPacked is true, and
+// otherwise the narrowest WideKey the state fits in (see visited.h), so
+// bigger boards go through the same loop without allocating per state.
+// Supports the move cap, pruning and the time and memory limits. The winning
+// state is noticed as soon as it is made, so fewer states are expanded than
+// with bf_path_finder.
+//
+// The search is run a few states at a time (see PathFinder in search.h).
+// Everything it needs is kept in between calls to step.
+
+template <class Key> class LevelSearch;
+
+template <class Key>
+class LevelPathFinder : public PathFinder {
+public:
+  LevelPathFinder(const Board *board, const SearchOptions &options);
+  ~LevelPathFinder();
+
+  bool step(long max_states);
+  void cancel();
+  bool done() const;
+  const SearchResult &result() const;
+  int upperBound() const;
+
+private:
+  LevelPathFinder(const LevelPathFinder &);
+  LevelPathFinder &operator=(const LevelPathFinder &);
+
+  LevelSearch<Key> *search;
+};
+
+// A LevelPathFinder with the right key for the board
+PathFinder *newLevelPathFinder(const Board *board, const SearchOptions &options);
+
+
+// The accessibility grid bf_accessibility works out (and the grid for each
+// robot if robot_grids isn't NULL), from a breadth first search over the
+// same packed states a level at a time. The states are expanded in the same
+// order with the same pruning, so the grids and the stats come out the same.
+// Takes no snapshots.
+std::vector<std::vector<int> > level_accessibility(const Board *board, const SearchOptions &options,
+                                                   SearchResult *result,
+                                                   std::vector<std::vector<std::vector<int> > > *robot_grids);
+
+#endif
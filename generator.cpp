@@ -0,0 +1,363 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include "generator.h"
+#include "bytes.h"
+
+
+static const char MAGIC[8] = { 'R', 'R', 'P', 'U', 'Z', 'Z', 'L', 'E' };
+static const unsigned int VERSION = 1;
+
+// the names robots are given, in order
+static const char ROBOT_NAMES[] = "RGBYSACDEFHIJKLMNOPQTUVWXZ";
+
+
+// ==================================================================
+// ==================================================================
+// Making and checking candidates
+
+static Board random_board(const GeneratorOptions &options, std::mt19937_64 &rng) {
+  int rows = options.rows;
+  int cols = options.cols;
+  Board board(rows, cols);
+  std::uniform_int_distribution<int> random_row(1, rows);
+  std::uniform_int_distribution<int> random_col(1, cols);
+
+  // a wall above or below the cell, and one to its left or right (the ones on
+  // the edge of the board are there already)
+  int walls = (options.walls == -1) ? rows * cols / 16 : options.walls;
+  for (int w = 0; w < walls; ++w) {
+    int r = random_row(rng);
+    int c = random_col(rng);
+    int corner = rng() % 4;
+    double h = (corner & 1) ? r + 0.5 : r - 0.5;
+    double v = (corner & 2) ? c + 0.5 : c - 0.5;
+    if (h > 1 && h < rows && !board.getHorizontalWall(h, c))
+      board.addHorizontalWall(h, c);
+    if (v > 1 && v < cols && !board.getVerticalWall(r, v))
+      board.addVerticalWall(r, v);
+  }
+
+  // the robots, each on a cell of its own
+  std::vector<bool> taken(rows * cols, false);
+  for (int i = 0; i < options.num_robots; ) {
+    Position p(random_row(rng), random_col(rng));
+    int cell = (p.row - 1) * cols + (p.col - 1);
+    if (!taken[cell]) {
+      taken[cell] = true;
+      board.placeRobot(p, ROBOT_NAMES[i++]);
+    }
+  }
+  return board;
+}
+
+// Sets the goal to a cell that takes exactly options.moves moves to get to,
+// if there is one. Returns false if not.
+static bool place_goal(Board &board, const GeneratorOptions &options, std::mt19937_64 &rng) {
+  SearchOptions search(options.search);
+  search.max_moves = options.moves;
+  search.all_paths = false;
+  search.prune = true;
+  search.hybrid = false;
+  search.processes = 1;
+  search.checkpoint_file = "";
+  search.resume_file = "";
+  SearchResult result;
+  std::vector<std::vector<std::vector<int> > > robot_grids;
+  std::vector<std::vector<int> > grid =
+    bf_accessibility(&board, search, &result, options.goal_any ? NULL : &robot_grids);
+  if (result.status != SEARCH_COMPLETE)
+    return false;
+
+  // every (robot, cell) pair that would make a puzzle of the right length,
+  // leaving out the cells the robots start on
+  if (options.goal_any)
+    robot_grids.push_back(grid);
+  for (int i = 0; i < board.numRobots(); ++i) {
+    Position p = board.getRobotPosition(i);
+    for (int j = 0; j < robot_grids.size(); ++j)
+      robot_grids[j][p.row-1][p.col-1] = -1;
+  }
+  std::vector<std::pair<int, Position> > goals;
+  for (int i = 0; i < robot_grids.size(); ++i) {
+    for (int r = 1; r <= board.getRows(); ++r) {
+      for (int c = 1; c <= board.getCols(); ++c) {
+        if (robot_grids[i][r-1][c-1] == options.moves)
+          goals.push_back(std::make_pair(i, Position(r, c)));
+      }
+    }
+  }
+  if (goals.empty())
+    return false;
+  std::pair<int, Position> goal = goals[rng() % goals.size()];
+  if (options.goal_any)
+    board.setGoal("any", goal.second);
+  else
+    board.setGoal(std::string(1, board.getRobot(goal.first)), goal.second);
+  return true;
+}
+
+
+// ==================================================================
+// ==================================================================
+// Writing puzzles out
+
+void write_puzzle(const Board &board, std::ostream &out) {
+  out << board.getRows() << " " << board.getCols() << "\n\n";
+  for (int i = 0; i < board.numRobots(); ++i) {
+    Position p = board.getRobotPosition(i);
+    out << "robot " << board.getRobot(i) << " " << p.row << " " << p.col << "\n";
+  }
+  out << "goal ";
+  if (board.getGoalRobot() == -1)
+    out << "any";
+  else
+    out << board.getRobot(board.getGoalRobot());
+  out << " " << board.getGoal().row << " " << board.getGoal().col << "\n\n";
+  for (int r = 1; r < board.getRows(); ++r) {
+    for (int c = 1; c <= board.getCols(); ++c) {
+      if (board.getHorizontalWall(r + 0.5, c))
+        out << "horizontal_wall " << r << ".5 " << c << "\n";
+    }
+  }
+  for (int r = 1; r <= board.getRows(); ++r) {
+    for (int c = 1; c < board.getCols(); ++c) {
+      if (board.getVerticalWall(r, c + 0.5))
+        out << "vertical_wall " << r << " " << c << ".5\n";
+    }
+  }
+}
+
+// The payload of a record in the binary file
+static std::string archive_record(const Board &board, int moves) {
+  int rows = board.getRows();
+  int cols = board.getCols();
+  std::string buf;
+  put<unsigned short>(buf, rows);
+  put<unsigned short>(buf, cols);
+  put<unsigned char>(buf, moves);
+  put<unsigned char>(buf, board.numRobots());
+  put<signed char>(buf, board.getGoalRobot());
+  put<unsigned short>(buf, (board.getGoal().row - 1) * cols + (board.getGoal().col - 1));
+  for (int i = 0; i < board.numRobots(); ++i) {
+    Position p = board.getRobotPosition(i);
+    put<char>(buf, board.getRobot(i));
+    put<unsigned short>(buf, (p.row - 1) * cols + (p.col - 1));
+  }
+  std::vector<bool> bits;
+  for (int r = 1; r < rows; ++r) {
+    for (int c = 1; c <= cols; ++c)
+      bits.push_back(board.getHorizontalWall(r + 0.5, c));
+  }
+  for (int r = 1; r <= rows; ++r) {
+    for (int c = 1; c < cols; ++c)
+      bits.push_back(board.getVerticalWall(r, c + 0.5));
+  }
+  for (int i = 0; i < bits.size(); i += 8) {
+    unsigned char byte = 0;
+    for (int b = 0; b < 8 && i + b < bits.size(); ++b)
+      byte |= bits[i + b] << b;
+    put<unsigned char>(buf, byte);
+  }
+  return buf;
+}
+
+// Where the threads hand in the puzzles they've found
+class PuzzleWriter {
+public:
+  PuzzleWriter(const GeneratorOptions &o, const std::string &out) : options(o), output(out) {
+    written = 0;
+    failed = false;
+    if (options.binary) {
+      archive.open(output.c_str(), std::ios::binary | std::ios::trunc);
+      archive.write(MAGIC, sizeof(MAGIC));
+      archive.write((const char *)&VERSION, sizeof(VERSION));
+      if (!archive)
+        fail(output);
+    }
+  }
+
+  // whether enough puzzles have been written (or writing failed)
+  bool done() const { return written >= options.count || failed; }
+
+  void add(const Board &board) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (done())
+      return;
+    if (options.binary) {
+      std::string record = archive_record(board, options.moves);
+      unsigned int length = record.size();
+      archive.write((const char *)&length, sizeof(length));
+      archive.write(record.data(), record.size());
+      if (!archive)
+        return fail(output);
+    }
+    else {
+      std::ostringstream name;
+      name << output << "_" << (written + 1) << "_" << options.moves << "moves.txt";
+      std::ofstream out(name.str().c_str());
+      write_puzzle(board, out);
+      if (!out)
+        return fail(name.str());
+    }
+    written++;
+  }
+
+  std::string error;
+
+private:
+  void fail(const std::string &filename) {
+    error = "could not write " + filename;
+    failed = true;
+  }
+
+  const GeneratorOptions &options;
+  std::string output;
+  std::ofstream archive;
+  std::mutex mutex;
+  std::atomic<long> written;
+  std::atomic<bool> failed;
+};
+
+bool generate_puzzles(const GeneratorOptions &options, const std::string &output,
+                      long &candidates, std::string &error) {
+  if (options.num_robots < 1 || options.num_robots >= sizeof(ROBOT_NAMES) ||
+      options.num_robots + 1 > options.rows * options.cols ||
+      options.rows > 256 || options.cols > 256 || options.moves > 255) {
+    error = "can't make puzzles of that size";
+    return false;
+  }
+  PuzzleWriter writer(options, output);
+  std::atomic<long> tried(0);
+  int threads = options.threads;
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  unsigned long long seed = options.seed;
+  if (seed == 0)
+    seed = std::random_device()();
+
+  // each thread has its own random numbers, so no two try the same boards
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.push_back(std::thread([&, t]() {
+      std::mt19937_64 rng(seed + t * 0x9E3779B97F4A7C15ULL);
+      while (!writer.done()) {
+        Board board = random_board(options, rng);
+        tried++;
+        if (place_goal(board, options, rng))
+          writer.add(board);
+      }
+    }));
+  }
+  for (int t = 0; t < workers.size(); ++t)
+    workers[t].join();
+  candidates = tried;
+  error = writer.error;
+  return error.empty();
+}
+
+
+// ==================================================================
+// ==================================================================
+// Reading puzzles back in
+
+bool is_puzzle_archive(const std::string &filename) {
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  char magic[sizeof(MAGIC)];
+  return in.read(magic, sizeof(magic)) && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool read_puzzle_archive(const std::string &filename, long index, Board &board, std::string &error) {
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  char magic[sizeof(MAGIC)];
+  unsigned int version = 0;
+  if (!in.read(magic, sizeof(magic)) || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      !in.read((char *)&version, sizeof(version)) || version != VERSION) {
+    error = filename + " is not a puzzle file this version can read";
+    return false;
+  }
+
+  // skip over the records before it
+  unsigned int length = 0;
+  for (long i = 0; ; ++i) {
+    if (!in.read((char *)&length, sizeof(length))) {
+      std::ostringstream message;
+      message << filename << " only has " << i << " puzzles";
+      error = message.str();
+      return false;
+    }
+    if (i == index)
+      break;
+    in.seekg(length, std::ios::cur);
+  }
+  std::string buf(length, '\0');
+  in.read(&buf[0], length);
+
+  Reader reader(buf);
+  reader.failed = !in;
+  int rows = reader.get<unsigned short>();
+  int cols = reader.get<unsigned short>();
+  reader.get<unsigned char>();
+  int num_robots = reader.get<unsigned char>();
+  int goal_robot = reader.get<signed char>();
+  int goal = reader.cell(rows * cols);
+  std::vector<char> names;
+  std::vector<int> cells;
+  for (int i = 0; i < num_robots; ++i) {
+    names.push_back(reader.get<char>());
+    cells.push_back(reader.cell(rows * cols));
+  }
+  int num_bits = (rows - 1) * cols + rows * (cols - 1);
+  if (reader.failed || rows < 1 || cols < 1 || reader.left() < (num_bits + 7) / 8) {
+    error = filename + " is cut short";
+    return false;
+  }
+  if (goal_robot < -1 || goal_robot >= num_robots) {
+    error = filename + " has a goal for a robot that isn't there";
+    return false;
+  }
+  // (the board asserts all of these, so they have to be caught here)
+  for (int i = 0; i < num_robots; ++i) {
+    if (names[i] < 'A' || names[i] > 'Z') {
+      error = filename + " has a robot that isn't named with a capital letter";
+      return false;
+    }
+    if (cells[i] == goal) {
+      error = filename + " has a robot on the goal";
+      return false;
+    }
+    for (int j = 0; j < i; ++j) {
+      if (names[j] == names[i] || cells[j] == cells[i]) {
+        error = filename + " has two robots with the same name or on the same cell";
+        return false;
+      }
+    }
+  }
+  size_t pos = reader.pos;
+
+  board = Board(rows, cols);
+  int bit = 0;
+  for (int r = 1; r < rows; ++r) {
+    for (int c = 1; c <= cols; ++c, ++bit) {
+      if (buf[pos + bit / 8] & (1 << (bit % 8)))
+        board.addHorizontalWall(r + 0.5, c);
+    }
+  }
+  for (int r = 1; r <= rows; ++r) {
+    for (int c = 1; c < cols; ++c, ++bit) {
+      if (buf[pos + bit / 8] & (1 << (bit % 8)))
+        board.addVerticalWall(r, c + 0.5);
+    }
+  }
+  for (int i = 0; i < num_robots; ++i)
+    board.placeRobot(Position(cells[i] / cols + 1, cells[i] % cols + 1), names[i]);
+  board.setGoal(goal_robot == -1 ? std::string("any") : std::string(1, names[goal_robot]),
+                Position(goal / cols + 1, goal % cols + 1));
+  return true;
+}
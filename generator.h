@@ -0,0 +1,89 @@
+#include <string>
+#include <ostream>
+
+#include "board.h"
+#include "search.h"
+
+#ifndef _generator_h_
+#define _generator_h_
+
+// ==================================================================
+// ==================================================================
+// Generates random puzzles whose shortest solution is exactly a given number
+// of moves.
+//
+// Each candidate is an empty board with random corner walls (a horizontal
+// and a vertical wall meeting at a cell, like the pieces of the real board)
+// and robots on random cells. One accessibility search, capped at the target
+// and keeping a map for each robot, then gives the fewest moves each robot
+// needs to get to each cell, which is the length of the shortest solution if
+// the goal were put there. So rather than guessing a goal and searching to
+// see how hard it turned out, the goal is picked out of the cells that take
+// exactly the target number of moves (for a random one of the robots, or any
+// robot with goal_any), and the candidate is only thrown out if there are
+// none or the search didn't finish.
+//
+// Several threads each make and check their own candidates, so the order of
+// the puzzles (though not which ones could come out) depends on timing when
+// there is more than one thread.
+//
+// Puzzles are written either as one text file each, in the same format the
+// solver reads, or all together in one binary file:
+//
+//   header:  magic, version
+//   record:  payload length, payload
+//   payload: rows, columns, moves, number of robots, goal robot (-1 for
+//            any), goal cell, then for each robot: name, cell, then one bit
+//            for each interior horizontal wall (row by row, under rows 1 to
+//            rows - 1) and each interior vertical wall (row by row, right of
+//            columns 1 to cols - 1)
+//
+// Cells are numbered (row - 1) * cols + (col - 1) and stored in 16 bits.
+
+class GeneratorOptions {
+public:
+  GeneratorOptions() : rows(16), cols(16), num_robots(4), walls(-1), moves(8),
+    count(100), threads(0), seed(0), goal_any(false), binary(false) {}
+
+  // the board, and how many corner walls to put on it (-1 for one for
+  // every 16 cells)
+  int rows;
+  int cols;
+  int num_robots;
+  int walls;
+  // the length of the shortest solution of every puzzle
+  int moves;
+  // how many puzzles to make
+  long count;
+  // how many threads check candidates (0 for one per core)
+  int threads;
+  // where the random numbers start (0 for a different place every time)
+  unsigned long long seed;
+  // let any robot reach the goal, rather than one picked at random
+  bool goal_any;
+  // write one binary file rather than a text file for each puzzle
+  bool binary;
+  // the time and memory limits for checking each candidate. The rest of the
+  // options are set by the generator.
+  SearchOptions search;
+};
+
+// Writes options.count puzzles, to output (binary) or to files named
+// output_<#>_<moves>moves.txt (text), and sets candidates to how many boards
+// were tried. Returns false, with the reason in error, if the output can't be
+// written.
+bool generate_puzzles(const GeneratorOptions &options, const std::string &output,
+                      long &candidates, std::string &error);
+
+// Writes the board in the format the solver reads
+void write_puzzle(const Board &board, std::ostream &out);
+
+// Whether the file is a binary file of generated puzzles
+bool is_puzzle_archive(const std::string &filename);
+
+// Reads the puzzle at index (counting from 0) out of a binary file of
+// generated puzzles. Returns false, with the reason in error, if there's no
+// such puzzle.
+bool read_puzzle_archive(const std::string &filename, long index, Board &board, std::string &error);
+
+#endif
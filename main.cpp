@@ -3,14 +3,18 @@
 #include <iomanip>
 #include <string>
 #include <cassert>
+#include <cmath>
 #include <cstdlib>
 #include <fstream>
-#include <queue>
-#include <algorithm>
 #include <vector>
+#include <chrono>
 
 #include "board.h"
 #include "boardstate.h"
+#include "search.h"
+#include "analyzer.h"
+#include "generator.h"
+#include "solver.h"
 
 // ================================================================
 // ================================================================
@@ -22,14 +26,44 @@ bool usage(const std::string &executable_name) {
   std::cerr << "       " << executable_name << " <puzzle_file> -visualize_accessibility" << std::endl;
   std::cerr << "       " << executable_name << " <puzzle_file> -max_moves <#> -all_solutions" << std::endl;
   std::cerr << "       " << executable_name << " <puzzle_file> -max_moves <#> -visualize_accessibility" << std::endl;
+  std::cerr << "  any of the above may also be given -prune_moves, -time_limit <seconds>" << std::endl;
+  std::cerr << "  -memory_limit <megabytes> and -hybrid (switch to iterative deepening instead" << std::endl;
+  std::cerr << "  of stopping when memory runs out) and -processes <#>" << std::endl;
+  std::cerr << "  a single process search may also be given -checkpoint <file> (with" << std::endl;
+  std::cerr << "  -checkpoint_interval <seconds>, 60 by default) and -resume <file>" << std::endl;
+  std::cerr << "  -edits <file> applies the wall edits in the file one at a time (lines like" << std::endl;
+  std::cerr << "  \"add horizontal_wall 3.5 4\" or \"remove vertical_wall 2 5.5\") and prints" << std::endl;
+  std::cerr << "  the solution length (or accessibility) after each" << std::endl;
+  std::cerr << "  -format <ascii|compact|json> picks the output (ascii, with the board drawn" << std::endl;
+  std::cerr << "  after every move, by default), and -stats adds stats to compact output" << std::endl;
+  std::cerr << "  -per_robot adds a map for each robot on its own to -visualize_accessibility" << std::endl;
+  std::cerr << "  -puzzle <#> picks a puzzle out of a file written by -generate -binary" << std::endl;
+  std::cerr << "  -progress <#> searches that many states at a time, printing how far it has" << std::endl;
+  std::cerr << "  got (to stderr) in between" << std::endl;
+  std::cerr << "       " << executable_name << " -generate <output> -moves <#> -count <#>" << std::endl;
+  std::cerr << "  makes random puzzles needing exactly that many moves, and may also be given" << std::endl;
+  std::cerr << "  -rows <#>, -cols <#>, -robots <#>, -walls <#>, -goal_any, -threads <#>," << std::endl;
+  std::cerr << "  -seed <#>, -binary (one file instead of one per puzzle), and -time_limit" << std::endl;
+  std::cerr << "  <seconds> and -memory_limit <megabytes> for checking each candidate" << std::endl;
   exit(0);
 }
 
 
 // ================================================================
 // ================================================================
-// load a Ricochet Robots puzzle from the input file
-Board load(const std::string &executable, const std::string &filename) {
+// load a Ricochet Robots puzzle from the input file (or the puzzle at index
+// if it was written by -generate -binary)
+Board load(const std::string &executable, const std::string &filename, long index) {
+
+  if (is_puzzle_archive(filename)) {
+    Board answer;
+    std::string error;
+    if (!read_puzzle_archive(filename, index, answer, error)) {
+      std::cerr << "ERROR: " << error << std::endl;
+      exit(0);
+    }
+    return answer;
+  }
 
   // open the file for reading
   std::ifstream istr (filename.c_str());
@@ -79,120 +113,363 @@ Board load(const std::string &executable, const std::string &filename) {
 
 // ================================================================
 // ================================================================
+// If the search couldn't be run at all, say why and return true
+bool print_error(const SearchResult &result) {
+  if (result.status != SEARCH_ERROR)
+    return false;
+  std::cerr << "ERROR: " << result.error << std::endl;
+  return true;
+}
 
-// function to calculate accessibility
-std::vector<std::vector<int> > bf_accessibility(Board *board, int max_moves = -1) {
-  
-  std::vector<std::vector<int> > grid(board->getRows(), std::vector<int>(board->getCols(), -1));
-  
-  // Set initial robot positions to 0.
-  for (int i = 0; i < board->numRobots(); ++i) {
-    Position pos = board->getRobotPosition(i);
-    grid[pos.row-1][pos.col-1] = 0;
+// If the search was cut short, say why and how far it got
+void print_cancelled(const SearchResult &result, bool accessibility = false) {
+  if (result.status == SEARCH_COMPLETE) {
+    return;
   }
+  std::cout << "search stopped: "
+    << (result.status == SEARCH_TIME_LIMIT ? "time limit reached" :
+        result.status == SEARCH_MEMORY_LIMIT ? "memory limit reached" : "cancelled")
+    << " after exploring " << result.states_explored << " states" << std::endl;
+  if (accessibility)
+    std::cout << "only counts of up to " << result.lower_bound << " moves are final" << std::endl;
+  else
+    std::cout << "no solution uses fewer than " << result.lower_bound << " moves" << std::endl;
+}
 
-  
-  BoardState initial(board);
-  initial.moves.push_back(std::vector<std::pair<char, std::string> >());
-
-  std::vector<BoardState> visited_states;
-  visited_states.push_back(initial);
-  
-  std::queue<BoardState> queued_states;
-  queued_states.push(initial);  
-  // Takes a state off the queue. If it wins and we aren't looking for all
-  // paths, we're done. else look at all the adjacent states and add them if we
-  // thet haven't already been visited.
-  while (!queued_states.empty()) {
-    BoardState cur_state(queued_states.front());
-    queued_states.pop();
-    int move_num = cur_state.moves[0].size() + 1;
-    // Stop adding states to queue after we reach max moves.
-    if (move_num <= max_moves || max_moves == -1) {
-      std::vector<BoardState> next_states = cur_state.get_adjacent();
-      for (int i = 0; i < next_states.size(); ++i) {
-        std::vector<BoardState>::iterator tmp = std::find(visited_states.begin(), visited_states.end(), next_states[i]);
-        if (tmp == visited_states.end()) {
-          visited_states.push_back(next_states[i]);
-          queued_states.push(next_states[i]);
-          for (int j = 0; j < next_states[i].bots.size(); ++j) {
-            Position pos = next_states[i].bots[j];
-            if (grid[pos.row-1][pos.col-1] > move_num || grid[pos.row-1][pos.col-1] == -1) {
-              grid[pos.row-1][pos.col-1] = move_num;
-            }
-          }
-        }
-      // (tmp->moves[0].size() > next_states[i].moves[0].size()) should never be
-      // true because the search is bredth first, meaning all moves of length
-      // n should be explored at the same time, i.e. there will never be a time
-      // when a state with move length n - 1 is explored after the same state
-      // with move length n. Right? *TODO* Determine if this is true!
-      }
+// ================================================================
+// ================================================================
+// print the fewest moves for any robot to get to each cell
+void print_accessibility(const std::vector<std::vector<int> > &access) {
+  std::cout << std::left;
+  for (int i = 0; i < access.size(); ++i) {
+    for (int j = 0; j < access[i].size(); ++j) {
+      if (access[i][j] != -1)
+        std::cout << std::setw(3) << access[i][j];
+      else
+        std::cout << std::setw(3) << '.';
     }
+    std::cout << "\n";
+  }
+}
+
+// the same for each robot on its own, after a line with its name
+void print_robot_accessibility(const Board &board,
+                               const std::vector<std::vector<std::vector<int> > > &robot_grids) {
+  for (int i = 0; i < robot_grids.size(); ++i) {
+    std::cout << "robot " << board.getRobot(i) << ":\n";
+    print_accessibility(robot_grids[i]);
   }
-  return grid;
 }
 
 // ================================================================
 // ================================================================
+// The -format json and -format compact output. Everything is put together
+// first and written out at once.
+
+const char *status_name(SearchStatus status) {
+  if (status == SEARCH_TIME_LIMIT) return "time_limit";
+  if (status == SEARCH_MEMORY_LIMIT) return "memory_limit";
+  if (status == SEARCH_CANCELLED) return "cancelled";
+  if (status == SEARCH_ERROR) return "error";
+  return "complete";
+}
 
-// Bredth first search algorithm finding the length of one path.
-std::vector<BoardState> bf_path_finder(Board *board, bool all_paths, int max_moves = -1) {
-  BoardState initial(board);
-  initial.moves.push_back(std::vector<std::pair<char, std::string> >());
-
-  std::vector<BoardState> visited_states;
-  visited_states.push_back(initial);
-  
-  std::queue<BoardState> queued_states;
-  queued_states.push(initial);
-  
-  std::vector<BoardState> winning_states;
-  
-  // Takes a state off the queue. If it wins and we aren't looking for all
-  // paths, we're done. else look at all the adjacent states and add them if we
-  // thet haven't already been visited.
-  while (!queued_states.empty()) {
-    BoardState cur_state(queued_states.front());
-    queued_states.pop();
-    if (cur_state.wins()) {
-      if (!all_paths) {
-        winning_states.push_back(cur_state);
-        return winning_states;
+void write_json_grid(std::ostringstream &out, const std::vector<std::vector<int> > &grid) {
+  out << "[";
+  for (int i = 0; i < grid.size(); ++i) {
+    out << (i ? ",[" : "[");
+    for (int j = 0; j < grid[i].size(); ++j)
+      out << (j ? "," : "") << grid[i][j];
+    out << "]";
+  }
+  out << "]";
+}
+
+// One object with the status, stats, and either the accessibility grid
+// (if access isn't NULL, with a grid per robot name if robot_grids isn't
+// NULL) or the solution length and every path found
+void print_json(const Board &board, const SearchResult &result,
+                const std::vector<std::vector<int> > *access,
+                const std::vector<std::vector<std::vector<int> > > *robot_grids = NULL) {
+  std::ostringstream out;
+  out << "{\"status\":\"" << status_name(result.status) << "\""
+      << ",\"states_explored\":" << result.states_explored
+      << ",\"lower_bound\":" << result.lower_bound;
+  if (access != NULL) {
+    out << ",\"accessibility\":";
+    write_json_grid(out, *access);
+    if (robot_grids != NULL) {
+      out << ",\"robots\":{";
+      for (int i = 0; i < robot_grids->size(); ++i) {
+        out << (i ? ",\"" : "\"") << board.getRobot(i) << "\":";
+        write_json_grid(out, (*robot_grids)[i]);
       }
-      if (cur_state.moves[0].size() < max_moves || max_moves == -1)
-        max_moves = cur_state.moves[0].size();
+      out << "}";
     }
-    // Stop adding states to queue after we reach max moves.
-    if (cur_state.moves[0].size() < max_moves) {
-      std::vector<BoardState> next_states = cur_state.get_adjacent();
-      for (int i = 0; i < next_states.size(); ++i) {
-        std::vector<BoardState>::iterator tmp = std::find(visited_states.begin(), visited_states.end(), next_states[i]);
-        if (tmp == visited_states.end()) {
-          visited_states.push_back(next_states[i]);
-          queued_states.push(next_states[i]);
+  }
+  else {
+    const std::vector<BoardState> &solutions = result.solutions;
+    if (solutions.empty())
+      out << ",\"moves\":null";
+    else
+      out << ",\"moves\":" << solutions[0].moves[0].size();
+    out << ",\"solutions\":[";
+    bool first = true;
+    for (int i = 0; i < solutions.size(); ++i) {
+      for (int p = 0; p < solutions[i].moves.size(); ++p) {
+        out << (first ? "[" : ",[");
+        first = false;
+        for (int m = 0; m < solutions[i].moves[p].size(); ++m) {
+          out << (m ? "," : "") << "[\"" << solutions[i].moves[p][m].first << "\",\""
+              << solutions[i].moves[p][m].second << "\"]";
         }
-        else if (tmp->moves[0].size() == next_states[i].moves[0].size() && all_paths) {
-          tmp->merge_paths(next_states[i]);
-          queued_states.push(next_states[i]);
+        out << "]";
+      }
+    }
+    out << "]";
+  }
+  out << "}\n";
+  std::cout << out.str();
+}
+
+void write_compact_grid(std::ostringstream &out, const std::vector<std::vector<int> > &grid) {
+  for (int i = 0; i < grid.size(); ++i) {
+    for (int j = 0; j < grid[i].size(); ++j) {
+      out << (j ? " " : "");
+      if (grid[i][j] == -1)
+        out << '.';
+      else
+        out << grid[i][j];
+    }
+    out << "\n";
+  }
+}
+
+// A line per path ("A north, B east, ...") after a line giving the count and
+// length, or the accessibility grid (and one per robot after its name), with
+// the stats at the end if asked for
+void print_compact(const Board &board, const SearchResult &result,
+                   const std::vector<std::vector<int> > *access, int max_moves, bool stats,
+                   const std::vector<std::vector<std::vector<int> > > *robot_grids = NULL) {
+  std::ostringstream out;
+  if (result.status != SEARCH_COMPLETE) {
+    out << "stopped: " << status_name(result.status) << ", "
+        << (access != NULL ? "final up to " : "no solution under ") << result.lower_bound << " moves\n";
+  }
+  if (access != NULL) {
+    write_compact_grid(out, *access);
+    for (int i = 0; robot_grids != NULL && i < robot_grids->size(); ++i) {
+      out << "robot " << board.getRobot(i) << ":\n";
+      write_compact_grid(out, (*robot_grids)[i]);
+    }
+  }
+  else {
+    const std::vector<BoardState> &solutions = result.solutions;
+    int num_solutions = 0;
+    for (int i = 0; i < solutions.size(); ++i)
+      num_solutions += solutions[i].moves.size();
+    if (num_solutions != 0)
+      out << num_solutions << " x " << solutions[0].moves[0].size() << " moves\n";
+    // (a search that stopped early has already said so, and there may still
+    // be solutions)
+    else if (result.status == SEARCH_COMPLETE && max_moves == -1)
+      out << "no solutions\n";
+    else if (result.status == SEARCH_COMPLETE)
+      out << "no solutions with " << max_moves << " or fewer moves\n";
+    for (int i = 0; i < solutions.size(); ++i) {
+      for (int p = 0; p < solutions[i].moves.size(); ++p) {
+        for (int m = 0; m < solutions[i].moves[p].size(); ++m) {
+          out << (m ? ", " : "") << solutions[i].moves[p][m].first << " "
+              << solutions[i].moves[p][m].second;
         }
-      // (tmp->moves[0].size() > next_states[i].moves[0].size()) should never be
-      // true because the search is bredth first, meaning all moves of length
-      // n should be explored at the same time, i.e. there will never be a time
-      // when a state with move length n - 1 is explored after the same state
-      // with move length n. Right? *TODO* Determine if this is true!
+        out << "\n";
       }
     }
   }
-  std::vector<BoardState>::iterator itr = visited_states.begin();
-  for (itr = visited_states.begin(); itr != visited_states.end(); ++itr) {
-    if (itr->wins() && itr->moves[0].size() == max_moves) {
-      winning_states.push_back(*itr);
+  if (stats)
+    out << "explored " << result.states_explored << " states\n";
+  std::cout << out.str();
+}
+
+// ================================================================
+// ================================================================
+// Find the solution, and with -progress run the search a slice of that many
+// states at a time, saying how far it has got after each slice
+SearchResult solve(Board &board, const SearchOptions &options, long progress_states) {
+  // (a search split over processes can't be stopped in between)
+  if (progress_states <= 0 || (options.processes > 1 && options.checkpoint_file.empty() &&
+                               options.resume_file.empty()))
+    return bf_path_finder(&board, options);
+  SearchResult answer;
+  SolvePool pool(progress_states);
+  pool.submit(board, options, [&answer](const SolveProgress &progress) {
+    if (progress.finished) {
+      answer = progress.result;
+      return;
+    }
+    std::cerr << "explored " << progress.result.states_explored << " states, no solution uses fewer than "
+      << progress.result.lower_bound << " moves";
+    if (progress.upper_bound != -1)
+      std::cerr << ", one uses " << progress.upper_bound;
+    std::cerr << std::endl;
+  });
+  pool.run(1);
+  return answer;
+}
+
+// ================================================================
+// ================================================================
+// Whether a wall edit can be made: the wall has to be an interior one, and
+// be there to remove or not there to add
+bool wall_edit_ok(const Board &board, const std::string &action, bool horizontal, double r, double c) {
+  double half = horizontal ? r : c;
+  double whole = horizontal ? c : r;
+  if (fabs((half - floor(half)) - 0.5) > 0.005 || whole != floor(whole))
+    return false;
+  if (r < 1 || r > board.getRows() || c < 1 || c > board.getCols())
+    return false;
+  bool there = horizontal ? board.getHorizontalWall(r, c) : board.getVerticalWall(r, c);
+  return action == "add" ? !there : there;
+}
+
+// ================================================================
+// ================================================================
+// Apply each wall edit in the file in turn, reporting the analysis of the
+// board after each one and whether it had to be searched for again
+void run_edits(const std::string &executable, const std::string &filename, const Board &board,
+               const SearchOptions &options, bool accessibility) {
+  std::ifstream istr (filename.c_str());
+  if (!istr) {
+    std::cerr << "ERROR: could not open " << filename << " for reading" << std::endl;
+    usage(executable);
+  }
+  IncrementalAnalyzer analyzer(board, options);
+  std::string edit = "initial board";
+  bool skipped = false;
+  while (true) {
+    int searches = analyzer.searchesRun();
+    // (nothing has changed since the last report if the edit was skipped)
+    if (!skipped && accessibility) {
+      const std::vector<std::vector<int> > &access = analyzer.accessibility();
+      std::cout << edit << (analyzer.searchesRun() == searches ? " (unchanged)" : "") << std::endl;
+      print_accessibility(access);
+    }
+    else if (!skipped) {
+      const SearchResult &result = analyzer.solution();
+      std::cout << edit << ": ";
+      if (result.status == SEARCH_ERROR)
+        std::cout << "search failed: " << result.error;
+      else if (result.status != SEARCH_COMPLETE)
+        std::cout << "search stopped, no solution uses fewer than " << result.lower_bound << " moves";
+      else if (result.solutions.empty())
+        std::cout << "no solutions";
+      else
+        std::cout << result.solutions[0].moves[0].size() << " moves";
+      std::cout << (analyzer.searchesRun() == searches ? " (unchanged)" : "") << std::endl;
+    }
+
+    // one edit a line (blank lines are passed over)
+    std::string line;
+    if (!std::getline(istr, line))
+      break;
+    std::istringstream fields(line);
+    std::string action, token, rest;
+    double r, c;
+    if (!(fields >> action)) {
+      skipped = true;
+      continue;
+    }
+    // a line that isn't an edit at all is reported and left out too
+    if ((action != "add" && action != "remove") || !(fields >> token) ||
+        (token != "horizontal_wall" && token != "vertical_wall") ||
+        !(fields >> r >> c) || (fields >> rest)) {
+      std::cerr << "ERROR: unknown edit \"" << line << "\" in " << filename << ", skipping it" << std::endl;
+      skipped = true;
+      continue;
     }
+    bool horizontal = (token == "horizontal_wall");
+    std::ostringstream label;
+    label << action << " " << token << " " << r << " " << c;
+    // an edit the board can't take is reported and left out
+    skipped = !wall_edit_ok(analyzer.getBoard(), action, horizontal, r, c);
+    if (skipped) {
+      std::cerr << "ERROR: can't " << label.str() << ", skipping it" << std::endl;
+      continue;
+    }
+    if (horizontal && action == "add") analyzer.addHorizontalWall(r, c);
+    else if (horizontal) analyzer.removeHorizontalWall(r, c);
+    else if (action == "add") analyzer.addVerticalWall(r, c);
+    else analyzer.removeVerticalWall(r, c);
+    edit = label.str();
   }
-  return winning_states;
 }
 
+// ================================================================
+// ================================================================
+// The -generate command line: make random puzzles and write them out
+int run_generate(int argc, char* argv[]) {
+  if (argc < 3) {
+    usage(argv[0]);
+  }
+  std::string output = argv[2];
+  GeneratorOptions options;
+  for (int arg = 3; arg < argc; arg++) {
+    std::string flag = argv[arg];
+    if (flag == "-goal_any") {
+      options.goal_any = true;
+    } else if (flag == "-binary") {
+      options.binary = true;
+    } else if (arg + 1 == argc) {
+      std::cout << "unknown command line argument" << argv[arg] << std::endl;
+      usage(argv[0]);
+    } else if (flag == "-moves") {
+      options.moves = atoi(argv[++arg]);
+      assert (options.moves > 0);
+    } else if (flag == "-count") {
+      options.count = atol(argv[++arg]);
+      assert (options.count > 0);
+    } else if (flag == "-rows") {
+      options.rows = atoi(argv[++arg]);
+      assert (options.rows > 0);
+    } else if (flag == "-cols") {
+      options.cols = atoi(argv[++arg]);
+      assert (options.cols > 0);
+    } else if (flag == "-robots") {
+      options.num_robots = atoi(argv[++arg]);
+      assert (options.num_robots > 0);
+    } else if (flag == "-walls") {
+      options.walls = atoi(argv[++arg]);
+      assert (options.walls >= 0);
+    } else if (flag == "-threads") {
+      options.threads = atoi(argv[++arg]);
+      assert (options.threads > 0);
+    } else if (flag == "-seed") {
+      options.seed = strtoull(argv[++arg], NULL, 10);
+    } else if (flag == "-time_limit") {
+      options.search.time_limit = atof(argv[++arg]);
+      assert (options.search.time_limit > 0);
+    } else if (flag == "-memory_limit") {
+      options.search.memory_limit = atol(argv[++arg]) * 1024 * 1024;
+      assert (options.search.memory_limit > 0);
+    } else {
+      std::cout << "unknown command line argument" << argv[arg] << std::endl;
+      usage(argv[0]);
+    }
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  long candidates = 0;
+  std::string error;
+  if (!generate_puzzles(options, output, candidates, error)) {
+    std::cerr << "ERROR: " << error << std::endl;
+    return 0;
+  }
+  std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+  std::cout << "wrote " << options.count << " puzzles needing " << options.moves << " moves ("
+            << candidates << " candidates checked in " << std::fixed << std::setprecision(1)
+            << seconds.count() << " seconds)" << std::endl;
+  return 0;
+}
 
 // ================================================================
 // ================================================================
@@ -203,6 +480,9 @@ int main(int argc, char* argv[]) {
   if (argc < 2) {
     usage(argv[0]);
   }
+  if (argv[1] == std::string("-generate")) {
+    return run_generate(argc, argv);
+  }
 
   // By default, the maximum number of moves is unlimited
   int max_moves = -1;
@@ -213,6 +493,40 @@ int main(int argc, char* argv[]) {
   // By default, do not visualize the accessibility
   bool visualize_accessibility = false;
 
+  // By default, generate every move from every state
+  bool prune_moves = false;
+
+  // By default, the search runs until it is done, however long it takes
+  double time_limit = -1;
+  long memory_limit = -1;
+
+  // By default, running out of memory stops the search
+  bool hybrid = false;
+
+  // By default, search in this process only
+  int processes = 1;
+
+  // By default, no snapshots are written, and the search starts from scratch
+  std::string checkpoint_file;
+  double checkpoint_interval = 60;
+  std::string resume_file;
+
+  // By default, the board is analyzed once as it is
+  std::string edits_file;
+
+  // By default, the board is drawn after every move of the solution
+  std::string format = "ascii";
+  bool stats = false;
+
+  // By default, accessibility is shown for all the robots together
+  bool per_robot = false;
+
+  // By default, a file of generated puzzles is read from the start
+  long puzzle_index = 0;
+
+  // By default, the search runs without reporting how it's going
+  long progress_states = 0;
+
   // Read in the other command line arguments
   for (int arg = 2; arg < argc; arg++) {
     if (argv[arg] == std::string("-all_solutions")) {
@@ -229,33 +543,154 @@ int main(int argc, char* argv[]) {
       // option, let's visualize where the robots can move and how many
       // steps it takes to get there
       visualize_accessibility = true;
+    } else if (argv[arg] == std::string("-prune_moves")) {
+      // skip moves that can't be part of a shortest path, and only try one
+      // order of moves that don't affect each other
+      prune_moves = true;
+    } else if (argv[arg] == std::string("-time_limit")) {
+      // the next command line arg is the number of seconds to search for
+      arg++;
+      assert (arg < argc);
+      time_limit = atof(argv[arg]);
+      assert (time_limit > 0);
+    } else if (argv[arg] == std::string("-memory_limit")) {
+      // the next command line arg is the number of megabytes the search may
+      // keep in stored states
+      arg++;
+      assert (arg < argc);
+      memory_limit = atol(argv[arg]) * 1024 * 1024;
+      assert (memory_limit > 0);
+    } else if (argv[arg] == std::string("-hybrid")) {
+      // when memory runs out, carry on with iterative deepening rather than
+      // giving up
+      hybrid = true;
+    } else if (argv[arg] == std::string("-processes")) {
+      // the next command line arg is the number of processes to split the
+      // search over
+      arg++;
+      assert (arg < argc);
+      processes = atoi(argv[arg]);
+      assert (processes > 0);
+    } else if (argv[arg] == std::string("-checkpoint")) {
+      // the next command line arg is the file to write snapshots of the
+      // search to
+      arg++;
+      assert (arg < argc);
+      checkpoint_file = argv[arg];
+    } else if (argv[arg] == std::string("-checkpoint_interval")) {
+      // the next command line arg is the number of seconds between snapshots
+      arg++;
+      assert (arg < argc);
+      checkpoint_interval = atof(argv[arg]);
+      assert (checkpoint_interval >= 0);
+    } else if (argv[arg] == std::string("-resume")) {
+      // the next command line arg is a snapshot to carry on the search from
+      arg++;
+      assert (arg < argc);
+      resume_file = argv[arg];
+    } else if (argv[arg] == std::string("-edits")) {
+      // the next command line arg is a file of wall edits to make to the
+      // board, analyzing it again after each
+      arg++;
+      assert (arg < argc);
+      edits_file = argv[arg];
+    } else if (argv[arg] == std::string("-format")) {
+      // the next command line arg is how to print the results
+      arg++;
+      assert (arg < argc);
+      format = argv[arg];
+      if (format != "ascii" && format != "compact" && format != "json") {
+        std::cerr << "ERROR: unknown format " << format << std::endl;
+        usage(argv[0]);
+      }
+    } else if (argv[arg] == std::string("-stats")) {
+      // include the number of states explored in compact output
+      stats = true;
+    } else if (argv[arg] == std::string("-per_robot")) {
+      // also show the accessibility of each robot on its own
+      per_robot = true;
+    } else if (argv[arg] == std::string("-puzzle")) {
+      // the next command line arg is which puzzle (counting from 0) to
+      // solve out of a file of generated puzzles
+      arg++;
+      assert (arg < argc);
+      puzzle_index = atol(argv[arg]);
+      assert (puzzle_index >= 0);
+    } else if (argv[arg] == std::string("-progress")) {
+      // the next command line arg is the number of states to search between
+      // progress reports
+      arg++;
+      assert (arg < argc);
+      progress_states = atol(argv[arg]);
+      assert (progress_states > 0);
     } else {
       std::cout << "unknown command line argument" << argv[arg] << std::endl;
       usage(argv[0]);
     }
   }
 
+  SearchOptions options;
+  options.max_moves = max_moves;
+  options.all_paths = all_solutions;
+  options.prune = prune_moves;
+  options.time_limit = time_limit;
+  options.memory_limit = memory_limit;
+  options.hybrid = hybrid;
+  options.processes = processes;
+  options.checkpoint_file = checkpoint_file;
+  options.checkpoint_interval = checkpoint_interval;
+  options.resume_file = resume_file;
+
   // Load the puzzle board from the input file
-  Board board = load(argv[0],argv[1]);
+  Board board = load(argv[0],argv[1],puzzle_index);
+  if (edits_file != "") {
+    run_edits(argv[0], edits_file, board, options, visualize_accessibility);
+    return 0;
+  }
   if (visualize_accessibility) {
-    int rows = board.getRows();
-    int cols = board.getCols();
-    std::vector<std::vector<int> > access = bf_accessibility(&board, max_moves);
-    std::cout << std::left;
-    for (int i = 0; i < rows; ++i) {
-      for (int j = 0; j < cols; ++j) {
-        if (access[i][j] != -1)
-          std::cout << std::setw(3) << access[i][j];
-        else
-          std::cout << std::setw(3) << '.';
-      }
-      std::cout << std::endl;
+    SearchResult result;
+    std::vector<std::vector<std::vector<int> > > robot_grids;
+    std::vector<std::vector<std::vector<int> > > *robots = per_robot ? &robot_grids : NULL;
+    std::vector<std::vector<int> > access = bf_accessibility(&board, options, &result, robots);
+    if (print_error(result))
+      return 1;
+    if (format == "json") {
+      print_json(board, result, &access, robots);
+      return 0;
     }
+    if (format == "compact") {
+      print_compact(board, result, &access, max_moves, stats, robots);
+      return 0;
+    }
+    print_cancelled(result, true);
+    print_accessibility(access);
+    if (per_robot)
+      print_robot_accessibility(board, robot_grids);
+    return 0;
+  }
+  if (format != "ascii") {
+    SearchResult result = solve(board, options, progress_states);
+    if (print_error(result))
+      return 1;
+    if (format == "json")
+      print_json(board, result, NULL);
+    else
+      print_compact(board, result, NULL, max_moves, stats);
     return 0;
   }
   board.print();
-  std::vector<BoardState> solutions = bf_path_finder(&board, all_solutions, max_moves);
-  
+  SearchResult result = solve(board, options, progress_states);
+  if (print_error(result))
+    return 1;
+  std::vector<BoardState> &solutions = result.solutions;
+  print_cancelled(result);
+  if (result.status != SEARCH_COMPLETE && solutions.empty()) {
+    return 0;
+  }
+  if (result.status != SEARCH_COMPLETE) {
+    std::cout << "best solution found so far:" << std::endl;
+  }
+
   if (solutions.empty() && max_moves == -1) {
     std::cout << "no solutions" << std::endl;
     return 0;
@@ -280,7 +715,7 @@ int main(int argc, char* argv[]) {
   else {
     int j;
     for (j = 0; j < solutions[0].moves[0].size(); ++j) {
-      std::cout << "robot " << solutions[0].moves[0][j].first << " moves " << solutions[0].moves[0][j].second << std::endl;
+      std::cout << "robot " << solutions[0].moves[0][j].first << " moves " << solutions[0].moves[0][j].second << "\n";
       board.moveRobot(board.whichRobot(solutions[0].moves[0][j].first), solutions[0].moves[0][j].second);
       board.print();
     }
@@ -0,0 +1,549 @@
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "partition.h"
+#include "visited.h"
+
+
+// ==================================================================
+// ==================================================================
+// The shared memory layout
+
+// most processes a search can be split over
+static const int MAX_PROCESSES = 16;
+// most moves a path can have (one byte per robot and direction)
+static const int MAX_PATH = 256;
+// successors each ring can hold before the sender has to wait
+static const long RING_SLOTS = 4096;
+// states each process expands between looks at the clock and the memory
+static const int LIMIT_CHECK_INTERVAL = 1024;
+// times a waiting process just gives up its turn before it starts sleeping
+static const int SPIN_WAITS = 1000;
+
+// What process to go with after each depth
+// (PATH_LIMIT is for paths too long to be traced back through the shared
+// memory, which isn't the same as the move cap the search was given)
+enum PartitionDecision { CONTINUE, FOUND, EXHAUSTED, MOVE_CAP, PATH_LIMIT, OUT_OF_TIME, OUT_OF_MEMORY };
+
+// A successor on its way to the process that owns it. move is the robot
+// times 4 plus the direction, or -1 for the starting state.
+class Message {
+public:
+  PackedState key;
+  PackedState parent;
+  int move;
+};
+
+// A ring written by one process and read by another. head is only written by
+// the reader and tail only by the writer, each on its own cache line.
+class Ring {
+public:
+  alignas(64) long head;
+  alignas(64) long tail;
+  Message slots[RING_SLOTS];
+};
+
+// Everything else the processes share. The rings follow it in the mapping,
+// the one from process i to process j at index i * processes + j.
+class Shared {
+public:
+  // the processes waiting at the barrier, and how many times they have all
+  // got there
+  long arrived;
+  long generation;
+  // set once a process has gone away, so the others stop waiting for it
+  int abandoned;
+  // how many times a process has finished expanding its part of a depth
+  long done;
+  // the first winning state found, and its depth (-1 if none yet)
+  int found_depth;
+  PackedState found_key;
+  // what each process had at the end of the last depth
+  long next_size[MAX_PROCESSES];
+  long explored[MAX_PROCESSES];
+  long memory[MAX_PROCESSES];
+  // OUT_OF_TIME or OUT_OF_MEMORY if a process ran into that limit before
+  // expanding all of its frontier (CONTINUE if not)
+  int cut_short[MAX_PROCESSES];
+  // made by one process after each depth, and followed by all of them
+  int decision;
+  // the state the path is being traced back through, and the path so far
+  PackedState trace_key;
+  int path[MAX_PATH];
+};
+
+
+// ==================================================================
+// ==================================================================
+// One process's share of the search
+
+class Parent {
+public:
+  PackedState parent;
+  int move;
+};
+
+class Partition {
+public:
+  int me;
+  int processes;
+  // (for the first process) the others, -1 once they have been waited for,
+  // and (for the others) the first process
+  std::vector<pid_t> children;
+  pid_t first;
+  Board *board;
+  Shared *shared;
+  Ring *rings;
+  int pruning;
+  // the cap or upper bound the moves left for PRUNE_BLOCKERS count against
+  int most_moves;
+  BlockerPruner *blockers;
+
+  // the states this process owns, with the state and move each came from
+  std::unordered_map<PackedState, Parent> seen;
+  // the owned states at the depth being generated
+  std::vector<PackedState> next;
+  int depth;
+  long explored;
+};
+
+static int owner(const Partition &p, PackedState key) {
+  // neighbouring states differ in a single byte, so mix the bits first
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  return key % p.processes;
+}
+
+// Whether every process is still there. Only the first process can wait for
+// the others, and they can only tell it's gone by being handed to another
+// parent. Once one has gone, it's marked in the shared memory for the rest.
+static bool still_running(Partition &p) {
+  if (__atomic_load_n(&p.shared->abandoned, __ATOMIC_ACQUIRE))
+    return false;
+  bool running = true;
+  if (p.me == 0) {
+    for (int i = 0; i < p.children.size(); ++i) {
+      if (p.children[i] != -1 && waitpid(p.children[i], NULL, WNOHANG) == p.children[i]) {
+        p.children[i] = -1;
+        running = false;
+      }
+    }
+  }
+  else if (getppid() != p.first) {
+    running = false;
+  }
+  if (!running)
+    __atomic_store_n(&p.shared->abandoned, 1, __ATOMIC_RELEASE);
+  return running;
+}
+
+// Gives up this process's turn while waiting on the others, sleeping a
+// little once it has been waiting a while
+static void back_off(int &waits) {
+  if (++waits < SPIN_WAITS)
+    std::this_thread::yield();
+  else
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+// Waits for every process to get here. Returns false if one went away
+// instead, and sets last for the process that got here last.
+static bool wait_all(Partition &p, bool *last = NULL) {
+  Shared *shared = p.shared;
+  long generation = __atomic_load_n(&shared->generation, __ATOMIC_ACQUIRE);
+  if (__atomic_add_fetch(&shared->arrived, 1, __ATOMIC_ACQ_REL) == p.processes) {
+    __atomic_store_n(&shared->arrived, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&shared->generation, generation + 1, __ATOMIC_RELEASE);
+    if (last != NULL)
+      *last = true;
+    return true;
+  }
+  if (last != NULL)
+    *last = false;
+  // (they've all got here once the generation moves on, whatever happens to
+  // any of them after that)
+  for (int waits = 0; __atomic_load_n(&shared->generation, __ATOMIC_ACQUIRE) == generation; ) {
+    if (!still_running(p))
+      return false;
+    back_off(waits);
+  }
+  return true;
+}
+
+static std::vector<Position> unpack(const Board *board, PackedState key) {
+  int cols = board->getCols();
+  int bits = cellBits(board);
+  std::vector<Position> bots(board->numRobots());
+  for (int i = 0; i < bots.size(); ++i) {
+    int cell = (key >> (bits * i)) & ((1ULL << bits) - 1);
+    bots[i] = Position(cell / cols + 1, cell % cols + 1);
+  }
+  return bots;
+}
+
+static PackedState pack(const Board *board, const std::vector<Position> &bots) {
+  PackedState key = 0;
+  int bits = cellBits(board);
+  for (int i = 0; i < bots.size(); ++i) {
+    PackedState cell = (bots[i].row - 1) * board->getCols() + (bots[i].col - 1);
+    key |= cell << (bits * i);
+  }
+  return key;
+}
+
+static bool wins(const Board *board, PackedState key) {
+  BoardState s(unpack(board, key), board, std::vector<std::vector<std::pair<char, std::string> > >());
+  return s.wins();
+}
+
+// A successor arrived (from this process or another one)
+static void receive(Partition &p, const Message &m) {
+  Parent from;
+  from.parent = m.parent;
+  from.move = m.move;
+  if (!p.seen.insert(std::make_pair(m.key, from)).second) {
+    return;
+  }
+  p.next.push_back(m.key);
+  if (wins(p.board, m.key)) {
+    int none = -1;
+    if (__atomic_compare_exchange_n(&p.shared->found_depth, &none, p.depth, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      p.shared->found_key = m.key;
+    }
+  }
+}
+
+// Takes in everything waiting in the rings sent to this process
+static void drain(Partition &p) {
+  for (int src = 0; src < p.processes; ++src) {
+    if (src == p.me)
+      continue;
+    Ring &ring = p.rings[src * p.processes + p.me];
+    long head = ring.head;
+    long tail = __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      receive(p, ring.slots[head % RING_SLOTS]);
+    }
+    __atomic_store_n(&ring.head, head, __ATOMIC_RELEASE);
+  }
+}
+
+static void send(Partition &p, const Message &m) {
+  int dest = owner(p, m.key);
+  if (dest == p.me) {
+    receive(p, m);
+    return;
+  }
+  Ring &ring = p.rings[p.me * p.processes + dest];
+  // if it's full, keep taking in our own messages so whoever we're waiting
+  // on isn't stuck waiting on us (unless it's gone, when nothing is sent)
+  for (int waits = 0; ring.tail - __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE) == RING_SLOTS; ) {
+    if (!still_running(p))
+      return;
+    drain(p);
+    back_off(waits);
+  }
+  ring.slots[ring.tail % RING_SLOTS] = m;
+  __atomic_store_n(&ring.tail, ring.tail + 1, __ATOMIC_RELEASE);
+}
+
+static void expand(Partition &p, PackedState key) {
+  BoardState s(unpack(p.board, key), p.board, std::vector<std::vector<std::pair<char, std::string> > >());
+  // put back the last move, so the pruning works the same as in one process
+  const Parent &from = p.seen[key];
+  if (from.move != -1) {
+    s.last_bot = from.move / 4;
+    s.last_dir = DIRECTIONS[from.move % 4];
+    s.last_from = unpack(p.board, from.parent)[s.last_bot];
+  }
+  std::vector<BoardState> next_states = s.get_adjacent(p.pruning, moves_left(p.most_moves, p.depth - 1),
+                                                      p.blockers);
+  for (int i = 0; i < next_states.size(); ++i) {
+    Message m;
+    m.key = pack(p.board, next_states[i].bots);
+    m.parent = key;
+    m.move = next_states[i].last_bot * 4 + directionIndex(next_states[i].last_dir);
+    send(p, m);
+  }
+  p.explored++;
+}
+
+static PartitionDecision decide(const Partition &p, const SearchOptions &options,
+                                std::chrono::steady_clock::time_point deadline) {
+  Shared *shared = p.shared;
+  if (shared->found_depth == p.depth) {
+    shared->trace_key = shared->found_key;
+    return FOUND;
+  }
+  long total = 0;
+  long memory = 0;
+  int cut_short = CONTINUE;
+  for (int i = 0; i < p.processes; ++i) {
+    total += shared->next_size[i];
+    memory += shared->memory[i];
+    if (shared->cut_short[i] != CONTINUE)
+      cut_short = shared->cut_short[i];
+  }
+  // a depth that wasn't finished can't say there's nothing more to find
+  if (cut_short != CONTINUE)
+    return (PartitionDecision)cut_short;
+  if (total == 0)
+    return EXHAUSTED;
+  if (options.max_moves != -1 && p.depth >= options.max_moves)
+    return MOVE_CAP;
+  if (p.depth + 1 >= MAX_PATH)
+    return PATH_LIMIT;
+  if (options.time_limit >= 0 && std::chrono::steady_clock::now() >= deadline)
+    return OUT_OF_TIME;
+  if (options.memory_limit >= 0 && memory > options.memory_limit)
+    return OUT_OF_MEMORY;
+  return CONTINUE;
+}
+
+// The bytes this process is taking up
+static long memory_used(const Partition &p, const std::vector<PackedState> &frontier) {
+  return p.seen.size() * HashVisitedSet::bytesPerState()
+    + (frontier.capacity() + p.next.capacity()) * sizeof(PackedState);
+}
+
+// Whether a limit has been reached part way through a depth. The memory
+// limit counts every process, as of when each last said how much it had.
+static PartitionDecision check_limits(Partition &p, const std::vector<PackedState> &frontier,
+                                      const SearchOptions &options,
+                                      std::chrono::steady_clock::time_point deadline) {
+  if (options.time_limit >= 0 && std::chrono::steady_clock::now() >= deadline)
+    return OUT_OF_TIME;
+  if (options.memory_limit >= 0) {
+    __atomic_store_n(&p.shared->memory[p.me], memory_used(p, frontier), __ATOMIC_RELAXED);
+    long memory = 0;
+    for (int i = 0; i < p.processes; ++i)
+      memory += __atomic_load_n(&p.shared->memory[i], __ATOMIC_RELAXED);
+    if (memory > options.memory_limit)
+      return OUT_OF_MEMORY;
+  }
+  return CONTINUE;
+}
+
+// The whole search as run by each process. Returns false if another process
+// went away part way through.
+static bool run_partition(Partition &p, const SearchOptions &options,
+                          std::chrono::steady_clock::time_point deadline) {
+  Shared *shared = p.shared;
+  BoardState initial(p.board);
+  PackedState start = pack(p.board, initial.bots);
+  std::vector<PackedState> frontier;
+  if (owner(p, start) == p.me) {
+    Parent none;
+    none.parent = 0;
+    none.move = -1;
+    p.seen[start] = none;
+    frontier.push_back(start);
+  }
+
+  p.depth = 0;
+  while (true) {
+    p.depth++;
+    shared->cut_short[p.me] = CONTINUE;
+    for (int i = 0; i < frontier.size(); ++i) {
+      // out of time or memory, so stop early (whoever decides will see that
+      // too)
+      if (i % LIMIT_CHECK_INTERVAL == LIMIT_CHECK_INTERVAL - 1) {
+        shared->cut_short[p.me] = check_limits(p, frontier, options, deadline);
+        if (shared->cut_short[p.me] != CONTINUE)
+          break;
+        if (!still_running(p))
+          return false;
+      }
+      expand(p, frontier[i]);
+    }
+
+    // Once every process has said it's done sending, one more pass through
+    // the rings picks up anything left.
+    __atomic_add_fetch(&shared->done, 1, __ATOMIC_ACQ_REL);
+    long target = (long)p.processes * p.depth;
+    for (int waits = 0; ; back_off(waits)) {
+      long done = __atomic_load_n(&shared->done, __ATOMIC_ACQUIRE);
+      drain(p);
+      if (done >= target)
+        break;
+      if (!still_running(p))
+        return false;
+    }
+
+    shared->next_size[p.me] = p.next.size();
+    shared->explored[p.me] = p.explored;
+    shared->memory[p.me] = memory_used(p, frontier);
+    bool last;
+    if (!wait_all(p, &last))
+      return false;
+    if (last)
+      shared->decision = decide(p, options, deadline);
+    if (!wait_all(p))
+      return false;
+    if (shared->decision != CONTINUE)
+      break;
+    frontier.swap(p.next);
+    p.next.clear();
+  }
+
+  if (shared->decision != FOUND)
+    return true;
+  // Trace the path back, each step done by the process owning the state
+  for (int step = p.depth; step >= 1; --step) {
+    PackedState key = shared->trace_key;
+    if (!wait_all(p))
+      return false;
+    if (owner(p, key) == p.me) {
+      const Parent &from = p.seen[key];
+      shared->path[step - 1] = from.move;
+      shared->trace_key = from.parent;
+    }
+    if (!wait_all(p))
+      return false;
+  }
+  return true;
+}
+
+
+// ==================================================================
+// ==================================================================
+
+SearchResult partitioned_path_finder(Board *board, const SearchOptions &options) {
+  SearchOptions single = options;
+  single.processes = 1;
+  int processes = options.processes;
+  if (processes > MAX_PROCESSES) {
+    std::cerr << "WARNING: using " << MAX_PROCESSES << " processes rather than " << processes << std::endl;
+    processes = MAX_PROCESSES;
+  }
+  if (options.all_paths || !fitsPacked(board) || processes < 2 || BoardState(board).wins()) {
+    return bf_path_finder(board, single);
+  }
+
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now();
+  if (options.time_limit >= 0) {
+    deadline += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(options.time_limit));
+  }
+
+  // shared memory has to be set up before forking so every process sees it
+  long bytes = sizeof(Shared) + (long)processes * processes * sizeof(Ring);
+  void *mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    std::cerr << "WARNING: could not set up shared memory, searching in one process" << std::endl;
+    return bf_path_finder(board, single);
+  }
+  Shared *shared = (Shared *)mem;
+  Ring *rings = (Ring *)((char *)mem + sizeof(Shared));
+  shared->arrived = 0;
+  shared->generation = 0;
+  shared->abandoned = 0;
+  shared->done = 0;
+  shared->found_depth = -1;
+
+  Partition p;
+  p.processes = processes;
+  p.board = board;
+  p.shared = shared;
+  p.rings = rings;
+  p.pruning = options.prune ? PRUNE_ALL : PRUNE_NONE;
+  p.most_moves = options.max_moves;
+  if (p.most_moves == -1 && options.prune)
+    p.most_moves = helper_robot_bound(board);
+  // (each process goes on with its own copy)
+  std::unique_ptr<BlockerPruner> blockers(newBlockerPruner(board, p.pruning));
+  p.blockers = blockers.get();
+  p.explored = 0;
+
+  // this process is number 0, the children are the rest
+  std::vector<pid_t> &children = p.children;
+  p.me = 0;
+  p.first = getpid();
+  for (int i = 1; i < processes; ++i) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      p.me = i;
+      p.children.clear();
+      run_partition(p, options, deadline);
+      _exit(0);
+    }
+    if (pid < 0) {
+      // The barrier expects them all, so the ones already started would wait
+      // forever. Stop them and search in this process instead.
+      std::cerr << "WARNING: could not start search process " << i
+                << ", searching in one process" << std::endl;
+      for (int j = 0; j < children.size(); ++j) {
+        kill(children[j], SIGKILL);
+        waitpid(children[j], NULL, 0);
+      }
+      munmap(mem, bytes);
+      return bf_path_finder(board, single);
+    }
+    children.push_back(pid);
+  }
+  bool finished = run_partition(p, options, deadline);
+  for (int i = 0; i < children.size(); ++i) {
+    // (the ones still there when a process went away would never finish)
+    if (children[i] != -1 && !finished)
+      kill(children[i], SIGKILL);
+    if (children[i] != -1)
+      waitpid(children[i], NULL, 0);
+  }
+
+  SearchResult result;
+  if (!finished) {
+    munmap(mem, bytes);
+    result.status = SEARCH_ERROR;
+    result.error = "a search process stopped part way through";
+    return result;
+  }
+  for (int i = 0; i < processes; ++i) {
+    result.states_explored += shared->explored[i];
+  }
+  int decision = shared->decision;
+  if (decision == FOUND) {
+    BoardState state(board);
+    state.moves.push_back(std::vector<std::pair<char, std::string> >());
+    for (int i = 0; i < p.depth; ++i) {
+      state = state.follow_edge(shared->path[i] / 4, DIRECTIONS[shared->path[i] % 4]);
+    }
+    result.solutions.push_back(state);
+    result.lower_bound = p.depth;
+  }
+  else if (decision == EXHAUSTED) {
+    // nothing new at this depth, so nothing at all
+    result.lower_bound = p.depth;
+  }
+  else if (decision == MOVE_CAP) {
+    result.lower_bound = p.depth + 1;
+  }
+  else if (decision == PATH_LIMIT) {
+    // there could still be a longer solution, so the search isn't complete
+    std::cerr << "WARNING: stopped at the longest path the search processes can trace ("
+              << MAX_PATH - 1 << " moves)" << std::endl;
+    result.status = SEARCH_CANCELLED;
+    result.lower_bound = p.depth + 1;
+  }
+  else {
+    result.status = (decision == OUT_OF_TIME) ? SEARCH_TIME_LIMIT : SEARCH_MEMORY_LIMIT;
+    // (every winning state is noticed as it's made, so only the depth that
+    // was cut short could still have one)
+    bool cut_short = false;
+    for (int i = 0; i < processes; ++i)
+      cut_short = cut_short || shared->cut_short[i] != CONTINUE;
+    result.lower_bound = cut_short ? p.depth : p.depth + 1;
+  }
+  munmap(mem, bytes);
+  return result;
+}
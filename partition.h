@@ -0,0 +1,30 @@
+#include "board.h"
+#include "search.h"
+
+#ifndef _partition_h_
+#define _partition_h_
+
+// ==================================================================
+// ==================================================================
+// Breadth first search split across several processes on the same machine.
+//
+// options.processes copies of the search run at once (this process and
+// options.processes - 1 forked children). Each one owns the packed states
+// that hash to it: it keeps their visited entries and expands them. Any
+// successor owned by another process is passed along through a ring buffer
+// in shared memory, one ring for each pair of processes. All the processes
+// finish a depth before any of them starts the next, and once one of them
+// finds a winning state the path is traced back through whichever process
+// owns each state along the way.
+//
+// Only finds a single path, and only on boards where fitsPacked is true.
+// Supports the move cap, pruning and the time and memory limits (the memory
+// limit counts all the processes together, and like the time limit is looked
+// at every so often as the states are expanded). If the processes can't all
+// be started, the search is done in this process instead. If one of them
+// goes away part way through (killed, or out of memory), the rest are
+// stopped and the search ends with SEARCH_ERROR.
+
+SearchResult partitioned_path_finder(Board *board, const SearchOptions &options);
+
+#endif
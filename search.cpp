@@ -0,0 +1,593 @@
+#include <deque>
+#include <algorithm>
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+#include <climits>
+
+#include "search.h"
+#include "visited.h"
+#include "deepening.h"
+#include "partition.h"
+#include "checkpoint.h"
+#include "frontier.h"
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the SearchBudget class
+
+// how many calls to exceeded() go by between looks at the clock
+static const int CLOCK_CHECK_INTERVAL = 256;
+
+SearchBudget::SearchBudget(const SearchOptions &options) {
+  status = SEARCH_COMPLETE;
+  has_deadline = options.time_limit >= 0;
+  if (has_deadline) {
+    deadline = std::chrono::steady_clock::now() +
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(options.time_limit));
+  }
+  memory_limit = options.memory_limit;
+  memory_used = 0;
+  table_bytes = 0;
+  calls = 0;
+  cancel_flag = NULL;
+}
+
+void SearchBudget::setMemoryLimit(long bytes) {
+  memory_limit = bytes;
+  if (status == SEARCH_MEMORY_LIMIT)
+    status = SEARCH_COMPLETE;
+}
+
+bool SearchBudget::exceeded() {
+  if (status != SEARCH_COMPLETE) {
+    return true;
+  }
+  if (cancel_flag != NULL && *cancel_flag) {
+    status = SEARCH_CANCELLED;
+    return true;
+  }
+  if (memory_limit >= 0 && memoryUsed() > memory_limit) {
+    status = SEARCH_MEMORY_LIMIT;
+    return true;
+  }
+  if (has_deadline && ++calls >= CLOCK_CHECK_INTERVAL) {
+    calls = 0;
+    if (std::chrono::steady_clock::now() >= deadline) {
+      status = SEARCH_TIME_LIMIT;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+// Loads the snapshot being resumed. If it can't be used the search is over,
+// and the reason goes in result.
+static bool resume(Checkpoint &checkpoint, VisitedSet *visited, std::deque<BoardState> &queue,
+                   std::vector<std::vector<int> > *grid,
+                   std::vector<std::vector<std::vector<int> > > *robot_grids, SearchResult &result) {
+  std::string error;
+  if (checkpoint.resume(visited, queue, grid, robot_grids, result.states_explored, error))
+    return true;
+  result.status = SEARCH_ERROR;
+  result.error = "could not resume the search: " + error;
+  return false;
+}
+
+
+// ================================================================
+// ================================================================
+
+// Breadth first search over the cells one robot can get to
+int single_robot_bound(const Board *board) {
+  int rows = board->getRows();
+  int cols = board->getCols();
+  BoardState start(board);
+  Position goal = board->getGoal();
+  int best = -1;
+  for (int bot = 0; bot < board->numRobots(); ++bot) {
+    if (board->getGoalRobot() != -1 && board->getGoalRobot() != bot)
+      continue;
+    std::vector<int> moves(rows * cols, -1);
+    std::deque<Position> queued;
+    Position from = start.bots[bot];
+    moves[(from.row - 1) * cols + (from.col - 1)] = 0;
+    queued.push_back(from);
+    while (!queued.empty()) {
+      Position pos = queued.front();
+      queued.pop_front();
+      int n = moves[(pos.row - 1) * cols + (pos.col - 1)];
+      if (pos == goal) {
+        if (best == -1 || n < best)
+          best = n;
+        break;
+      }
+      // the robot's old place is empty once it has moved
+      std::vector<Position> others = start.bots;
+      others[bot] = pos;
+      for (int d = 0; d < 4; ++d) {
+        Position to = start.moveRobot(pos, DIRECTIONS[d], others);
+        int &m = moves[(to.row - 1) * cols + (to.col - 1)];
+        if (m == -1) {
+          m = n + 1;
+          queued.push_back(to);
+        }
+      }
+    }
+  }
+  return best;
+}
+
+
+// Boards with more cells than this (16 by 16) are left at the one robot
+// bound, since every pair of cells is a state of the two robot search
+static const int HELPER_BOUND_MAX_CELLS = 256;
+
+// Where the robot at p ends up moving in direction d, with robots at bots
+// (as BoardState::moveRobot)
+static Position slide(const Board *board, const Position &p, int d, const std::vector<Position> &bots) {
+  Position stop = board->slideTo(p, d);
+  for (int i = 0; i < bots.size(); ++i) {
+    const Position &q = bots[i];
+    if (d == 0 && q.col == p.col && q.row < p.row && q.row >= stop.row)
+      stop.row = q.row + 1;
+    else if (d == 1 && q.row == p.row && q.col > p.col && q.col <= stop.col)
+      stop.col = q.col - 1;
+    else if (d == 2 && q.col == p.col && q.row > p.row && q.row <= stop.row)
+      stop.row = q.row - 1;
+    else if (d == 3 && q.row == p.row && q.col < p.col && q.col >= stop.col)
+      stop.col = q.col + 1;
+  }
+  return stop;
+}
+
+// Breadth first search over where each pair of robots can get to, one of
+// which can win, with the rest of them standing still
+int helper_robot_bound(const Board *board) {
+  int best = single_robot_bound(board);
+  int n = board->numRobots();
+  int cols = board->getCols();
+  int num_cells = board->getRows() * cols;
+  if (n < 2 || num_cells > HELPER_BOUND_MAX_CELLS)
+    return best;
+  int goal_robot = board->getGoalRobot();
+  Position goal = board->getGoal();
+  BoardState start(board);
+  // indexed by the first robot's cell times the number of cells plus the
+  // second one's
+  std::vector<bool> seen(num_cells * num_cells);
+  std::vector<std::pair<Position, Position> > level, next;
+  for (int a = 0; a < n; ++a) {
+    for (int b = a + 1; b < n; ++b) {
+      bool a_wins = (goal_robot == -1 || goal_robot == a);
+      bool b_wins = (goal_robot == -1 || goal_robot == b);
+      if (!a_wins && !b_wins)
+        continue;
+      std::vector<Position> bots = start.bots;
+      std::fill(seen.begin(), seen.end(), false);
+      seen[((bots[a].row - 1) * cols + bots[a].col - 1) * num_cells +
+           (bots[b].row - 1) * cols + bots[b].col - 1] = true;
+      level.assign(1, std::make_pair(bots[a], bots[b]));
+      // (a level that can't beat the best so far isn't worth looking at)
+      bool won = false;
+      for (int depth = 1; !won && !level.empty() && (best == -1 || depth < best); ++depth) {
+        next.clear();
+        for (int i = 0; !won && i < level.size(); ++i) {
+          bots[a] = level[i].first;
+          bots[b] = level[i].second;
+          for (int m = 0; !won && m < 8; ++m) {
+            std::pair<Position, Position> to = level[i];
+            if (m < 4)
+              to.first = slide(board, bots[a], m, bots);
+            else
+              to.second = slide(board, bots[b], m - 4, bots);
+            if ((a_wins && to.first == goal) || (b_wins && to.second == goal)) {
+              best = depth;
+              won = true;
+            }
+            int index = ((to.first.row - 1) * cols + to.first.col - 1) * num_cells +
+                        (to.second.row - 1) * cols + to.second.col - 1;
+            if (!seen[index]) {
+              seen[index] = true;
+              next.push_back(to);
+            }
+          }
+        }
+        level.swap(next);
+      }
+    }
+  }
+  return best;
+}
+
+// ================================================================
+// ================================================================
+
+// function to calculate accessibility
+std::vector<std::vector<int> > bf_accessibility(Board *board, const SearchOptions &options,
+                                                SearchResult *result,
+                                                std::vector<std::vector<std::vector<int> > > *robot_grids) {
+  // Without snapshots the packed states are all it takes (see frontier.h)
+  if (options.checkpoint_file.empty() && options.resume_file.empty())
+    return level_accessibility(board, options, result, robot_grids);
+  int max_moves = options.max_moves;
+  SearchBudget budget(options);
+  SearchResult stats;
+
+  std::vector<std::vector<int> > grid(board->getRows(), std::vector<int>(board->getCols(), -1));
+
+  // Set initial robot positions to 0.
+  for (int i = 0; i < board->numRobots(); ++i) {
+    Position pos = board->getRobotPosition(i);
+    grid[pos.row-1][pos.col-1] = 0;
+  }
+  if (robot_grids != NULL) {
+    robot_grids->assign(board->numRobots(), grid);
+    for (int i = 0; i < board->numRobots(); ++i) {
+      for (int r = 0; r < board->getRows(); ++r)
+        std::fill((*robot_grids)[i][r].begin(), (*robot_grids)[i][r].end(), -1);
+      Position pos = board->getRobotPosition(i);
+      (*robot_grids)[i][pos.row-1][pos.col-1] = 0;
+    }
+  }
+
+
+  BoardState initial(board);
+  initial.moves.push_back(std::vector<std::pair<char, std::string> >());
+
+  VisitedSet *visited_states = newVisitedSet(board, robot_grids == NULL, max_moves);
+  std::deque<BoardState> queued_states;
+  Checkpoint checkpoint(board, options, robot_grids == NULL ? SNAPSHOT_ACCESSIBILITY : SNAPSHOT_ROBOT_ACCESSIBILITY);
+  if (checkpoint.resuming()) {
+    if (!resume(checkpoint, visited_states, queued_states, &grid, robot_grids, stats)) {
+      delete visited_states;
+      if (result != NULL)
+        *result = stats;
+      return grid;
+    }
+    for (int i = 0; i < queued_states.size(); ++i)
+      budget.use(queued_states[i].memory_usage());
+  }
+  else {
+    visited_states->insert(initial, 0);
+    checkpoint.queued(initial);
+    queued_states.push_back(initial);
+    budget.use(initial.memory_usage());
+  }
+  budget.setTableBytes(visited_states->memoryUsage());
+  // the depth of the states last taken off the queue
+  int layer = queued_states.empty() ? 0 : queued_states.front().moves[0].size();
+  // Takes a state off the queue. If it wins and we aren't looking for all
+  // paths, we're done. else look at all the adjacent states and add them if we
+  // thet haven't already been visited.
+  while (!queued_states.empty()) {
+    if (budget.exceeded()) {
+      break;
+    }
+    if (queued_states.front().moves[0].size() != layer) {
+      layer = queued_states.front().moves[0].size();
+      checkpoint.startDepth(layer, &grid, robot_grids, stats.states_explored);
+    }
+    BoardState cur_state(queued_states.front());
+    queued_states.pop_front();
+    checkpoint.taken();
+    budget.release(cur_state.memory_usage());
+    stats.states_explored++;
+    stats.lower_bound = cur_state.moves[0].size();
+    int move_num = cur_state.moves[0].size() + 1;
+    // Stop adding states to queue after we reach max moves.
+    if (move_num <= max_moves || max_moves == -1) {
+      std::vector<BoardState> next_states = cur_state.get_adjacent(options.prune ? PRUNE_ALL : PRUNE_NONE);
+      for (int i = 0; i < next_states.size(); ++i) {
+        if (visited_states->insert(next_states[i], move_num) == VISITED_NEW) {
+          checkpoint.queued(next_states[i]);
+          queued_states.push_back(next_states[i]);
+          budget.use(next_states[i].memory_usage());
+          budget.setTableBytes(visited_states->memoryUsage());
+          for (int j = 0; j < next_states[i].bots.size(); ++j) {
+            Position pos = next_states[i].bots[j];
+            if (grid[pos.row-1][pos.col-1] > move_num || grid[pos.row-1][pos.col-1] == -1) {
+              grid[pos.row-1][pos.col-1] = move_num;
+            }
+            if (robot_grids != NULL && (*robot_grids)[j][pos.row-1][pos.col-1] == -1) {
+              // (states come off the queue in order, so the first time is the fewest moves)
+              (*robot_grids)[j][pos.row-1][pos.col-1] = move_num;
+            }
+          }
+        }
+      }
+    }
+  }
+  // a search stopped by a limit is the one most worth carrying on later
+  if (budget.status != SEARCH_COMPLETE)
+    checkpoint.stopped(layer, &grid, robot_grids, stats.states_explored);
+  delete visited_states;
+  stats.status = budget.status;
+  if (result != NULL) {
+    *result = stats;
+  }
+  return grid;
+}
+
+// ================================================================
+// ================================================================
+
+// Everything the queue search needs to carry along
+class QueueSearch {
+public:
+  QueueSearch(Board *b, const SearchOptions &o)
+    : board(b), options(o), blockers(NULL), budget(o), visited_states(NULL), deepening(NULL),
+      checkpoint(b, o, o.all_paths ? SNAPSHOT_ALL_PATHS : SNAPSHOT_PATH), cancelled(false) {}
+  ~QueueSearch() { delete deepening; delete visited_states; delete blockers; }
+
+  Board *board;
+  SearchOptions options;
+  bool all_paths;
+  int max_moves;
+  int pruning;
+  // what the moves left for PRUNE_BLOCKERS are counted against
+  int bound;
+  // (NULL unless PRUNE_BLOCKERS is used)
+  BlockerPruner *blockers;
+  bool hybrid;
+  long memory_limit;
+
+  SearchBudget budget;
+  SearchResult result;
+  VisitedSet *visited_states;
+  std::deque<BoardState> queued_states;
+  // set once the search has switched over to iterative deepening
+  DeepeningSearch *deepening;
+  Checkpoint checkpoint;
+  std::atomic<bool> cancelled;
+
+  // Set once a winning state has come off the queue (only when looking for
+  // all paths, otherwise the search is over right away). Before that,
+  // remember the first winning state generated so there is something to
+  // hand back if the search gets cancelled.
+  bool found;
+  std::vector<BoardState> best;
+  // the depth of the states last taken off the queue
+  int layer;
+  bool done;
+};
+
+// Winds the search up once the queue is done with
+static void finish(QueueSearch &s) {
+  SearchResult &result = s.result;
+  if (s.hybrid && s.budget.status == SEARCH_MEMORY_LIMIT) {
+    // Out of room for breadth first search. What's left on the queue is a
+    // complete frontier (every unfinished shortest path goes through one of
+    // those states), so carry on from there with iterative deepening.
+    // (the queue is handed over as it is, since a copy could take as much
+    // memory again as the limit that was just reached)
+    s.budget.setMemoryLimit(s.memory_limit);
+    s.deepening = new DeepeningSearch(s.board, s.queued_states, s.visited_states, s.options,
+                                      s.budget, result);
+    return;
+  }
+  s.done = true;
+  // (once a winning state has come off the queue the rest of the search
+  // isn't worth saving, since those solutions wouldn't be in the record)
+  if (s.budget.status != SEARCH_COMPLETE && !s.found)
+    s.checkpoint.stopped(s.layer, NULL, NULL, result.states_explored);
+  delete s.visited_states;
+  s.visited_states = NULL;
+  s.queued_states.clear();
+  result.status = s.budget.status;
+  if (result.status != SEARCH_COMPLETE && !s.found) {
+    // Cancelled before reaching the winning depth, so the best we have is
+    // whatever winning state turned up among the generated states.
+    result.solutions = s.best;
+    return;
+  }
+  if (result.status == SEARCH_COMPLETE && !s.found) {
+    // Ran out of states, so there is no solution within the cap
+    result.lower_bound = (s.max_moves == -1) ? result.lower_bound + 1 : s.max_moves + 1;
+  }
+}
+
+
+// ================================================================
+// ================================================================
+// Implementation of the QueuePathFinder class
+
+QueuePathFinder::QueuePathFinder(Board *board, const SearchOptions &options) {
+  search = new QueueSearch(board, options);
+  QueueSearch &s = *search;
+  s.all_paths = options.all_paths;
+  s.max_moves = options.max_moves;
+  // Reordering commuting moves would hide some of the equivalent paths, so
+  // only drop the useless moves when all of them are wanted.
+  s.pruning = PRUNE_NONE;
+  if (options.prune)
+    s.pruning = s.all_paths ? PRUNE_REVERSE | PRUNE_BLOCKERS : PRUNE_ALL;
+  s.bound = s.max_moves;
+  if (s.bound == -1 && (s.pruning & PRUNE_BLOCKERS))
+    s.bound = helper_robot_bound(board);
+  s.blockers = newBlockerPruner(board, s.pruning);
+
+  // When switching over to iterative deepening, the breadth first part only
+  // gets part of the memory so there is room left for the transposition table.
+  s.hybrid = options.hybrid && !s.all_paths;
+  s.memory_limit = options.memory_limit;
+  if (s.hybrid && s.memory_limit < 0)
+    s.memory_limit = DEFAULT_HYBRID_MEMORY;
+  if (s.hybrid)
+    s.budget.setMemoryLimit(s.memory_limit / 4 * 3);
+  s.budget.setCancelFlag(&s.cancelled);
+
+  BoardState initial(board);
+  initial.moves.push_back(std::vector<std::pair<char, std::string> >());
+
+  // Robots other than the goal robot can stand in for each other, unless
+  // every path is wanted (then paths with the robots swapped around are
+  // different solutions).
+  s.visited_states = newVisitedSet(board, !s.all_paths, s.max_moves);
+  s.found = false;
+  s.layer = 0;
+  s.done = false;
+  if (s.checkpoint.resuming()) {
+    if (!resume(s.checkpoint, s.visited_states, s.queued_states, NULL, NULL, s.result)) {
+      s.done = true;
+      return;
+    }
+    for (int i = 0; i < s.queued_states.size(); ++i)
+      s.budget.use(s.queued_states[i].memory_usage());
+  }
+  else {
+    s.visited_states->insert(initial, 0);
+    s.checkpoint.queued(initial);
+    s.queued_states.push_back(initial);
+    s.budget.use(initial.memory_usage());
+  }
+  s.budget.setTableBytes(s.visited_states->memoryUsage());
+
+  // Snapshots are taken between depths, so the first winning state generated
+  // so far (if any) is still on the queue
+  for (int i = 0; i < s.queued_states.size() && s.best.empty(); ++i) {
+    if (s.queued_states[i].wins())
+      s.best.push_back(s.queued_states[i]);
+  }
+  if (!s.queued_states.empty())
+    s.layer = s.queued_states.front().moves[0].size();
+}
+
+QueuePathFinder::~QueuePathFinder() {
+  delete search;
+}
+
+void QueuePathFinder::cancel() {
+  search->cancelled = true;
+}
+
+bool QueuePathFinder::done() const {
+  return search->done;
+}
+
+const SearchResult &QueuePathFinder::result() const {
+  return search->result;
+}
+
+int QueuePathFinder::upperBound() const {
+  if (!search->result.solutions.empty())
+    return search->result.solutions[0].moves[0].size();
+  if (!search->best.empty())
+    return search->best[0].moves[0].size();
+  return -1;
+}
+
+bool QueuePathFinder::step(long max_states) {
+  QueueSearch &s = *search;
+  SearchResult &result = s.result;
+  if (s.deepening != NULL) {
+    s.done = s.deepening->step(max_states);
+    return s.done;
+  }
+  long expanded = 0;
+  // Takes a state off the queue. If it wins and we aren't looking for all
+  // paths, we're done. else look at all the adjacent states and add them if we
+  // thet haven't already been visited.
+  while (!s.done && expanded < max_states) {
+    if (s.queued_states.empty() || s.budget.exceeded()) {
+      finish(s);
+      break;
+    }
+    // Everything left is longer than the solutions found, so we're done (and
+    // a snapshot taken now wouldn't have them)
+    if (s.found && s.queued_states.front().moves[0].size() > s.max_moves) {
+      finish(s);
+      break;
+    }
+    if (s.queued_states.front().moves[0].size() != s.layer) {
+      s.layer = s.queued_states.front().moves[0].size();
+      s.checkpoint.startDepth(s.layer, NULL, NULL, result.states_explored);
+    }
+    BoardState cur_state(s.queued_states.front());
+    s.queued_states.pop_front();
+    s.checkpoint.taken();
+    s.budget.release(cur_state.memory_usage());
+    result.states_explored++;
+    expanded++;
+    int depth = cur_state.moves[0].size();
+    // Everything with fewer moves has already come off the queue
+    if (!s.found)
+      result.lower_bound = depth;
+    if (cur_state.wins()) {
+      if (!s.all_paths) {
+        result.solutions.push_back(cur_state);
+        delete s.visited_states;
+        s.visited_states = NULL;
+        s.queued_states.clear();
+        s.done = true;
+        break;
+      }
+      if (depth < s.max_moves || s.max_moves == -1)
+        s.max_moves = depth;
+      if (depth == s.max_moves) {
+        // Collect all the paths to each winning state together
+        std::vector<BoardState>::iterator tmp = std::find(result.solutions.begin(), result.solutions.end(), cur_state);
+        if (tmp == result.solutions.end())
+          result.solutions.push_back(cur_state);
+        else
+          tmp->merge_paths(cur_state);
+      }
+      s.found = true;
+    }
+    // Stop adding states to queue after we reach max moves.
+    if (depth < s.max_moves || s.max_moves == -1) {
+      std::vector<BoardState> next_states = cur_state.get_adjacent(s.pruning, moves_left(s.bound, depth),
+                                                                   s.blockers);
+      for (int i = 0; i < next_states.size(); ++i) {
+        // Since the search is breadth first, a state that has been seen
+        // before was reached in the same number of moves or fewer.
+        int seen = s.visited_states->insert(next_states[i], depth + 1);
+        if (seen == VISITED_NEW) {
+          s.checkpoint.queued(next_states[i]);
+          s.queued_states.push_back(next_states[i]);
+          s.budget.use(next_states[i].memory_usage());
+          s.budget.setTableBytes(s.visited_states->memoryUsage());
+          if (s.best.empty() && next_states[i].wins()) {
+            s.best.push_back(next_states[i]);
+          }
+        }
+        else if (seen == VISITED_SAME_DEPTH && s.all_paths) {
+          // Another path of the same length. Follow it too, so that all the
+          // ways of getting to the goal through this state are found.
+          s.checkpoint.queued(next_states[i]);
+          s.queued_states.push_back(next_states[i]);
+          s.budget.use(next_states[i].memory_usage());
+        }
+      }
+    }
+  }
+  return s.done;
+}
+
+
+// ================================================================
+// ================================================================
+
+PathFinder *newPathFinder(Board *board, const SearchOptions &options) {
+  // A single path without snapshots or a switch to iterative deepening only
+  // needs the packed states (see frontier.h)
+  if (!options.all_paths && !options.hybrid && options.checkpoint_file.empty() &&
+      options.resume_file.empty())
+    return newLevelPathFinder(board, options);
+  return new QueuePathFinder(board, options);
+}
+
+// Bredth first search algorithm finding the length of one path.
+SearchResult bf_path_finder(Board *board, const SearchOptions &options) {
+  // (snapshots are only taken of the search in this process)
+  if (options.processes > 1 && options.checkpoint_file.empty() && options.resume_file.empty())
+    return partitioned_path_finder(board, options);
+  PathFinder *finder = newPathFinder(board, options);
+  while (!finder->step(LONG_MAX)) {}
+  SearchResult result = finder->result();
+  delete finder;
+  return result;
+}
@@ -0,0 +1,203 @@
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+
+#include "board.h"
+#include "boardstate.h"
+
+#ifndef _search_h_
+#define _search_h_
+
+// ==================================================================
+// ==================================================================
+// Options controlling a search. The defaults search without any limits,
+// exactly like the command line does when given no options.
+
+class SearchOptions {
+public:
+  SearchOptions() : max_moves(-1), all_paths(false), prune(false),
+    time_limit(-1), memory_limit(-1), hybrid(false), processes(1),
+    checkpoint_interval(60) {}
+
+  // cap on the number of moves (-1 for no cap)
+  int max_moves;
+  // find every shortest path rather than just the first one
+  bool all_paths;
+  // skip moves that can't be part of a shortest path (see get_adjacent)
+  bool prune;
+  // give up after this many seconds (-1 for no limit)
+  double time_limit;
+  // give up once the states being kept take more than this many bytes
+  // (-1 for no limit)
+  long memory_limit;
+  // instead of giving up when memory runs out, carry on from the current
+  // frontier with iterative deepening (only when finding a single path)
+  bool hybrid;
+  // split the search over this many processes (see partition.h)
+  int processes;
+  // write a snapshot of a single process breadth first search to this file
+  // every checkpoint_interval seconds, at the start of a depth (see
+  // checkpoint.h), or "" for none
+  std::string checkpoint_file;
+  double checkpoint_interval;
+  // carry on the search from this snapshot instead of starting over ("" for
+  // none). The puzzle and the other options must be the same as when it was
+  // written.
+  std::string resume_file;
+};
+
+// memory used by a hybrid search when no memory limit is given
+const long DEFAULT_HYBRID_MEMORY = 1024L * 1024 * 1024;
+
+
+// How a search ended. Anything other than SEARCH_COMPLETE means the search
+// was cancelled and the result only holds what was found up to that point.
+// SEARCH_CANCELLED is for searches stopped by whatever was running them, and
+// SEARCH_ERROR for ones that couldn't go on at all (the reason is in error).
+enum SearchStatus { SEARCH_COMPLETE, SEARCH_TIME_LIMIT, SEARCH_MEMORY_LIMIT, SEARCH_CANCELLED,
+                    SEARCH_ERROR };
+
+class SearchResult {
+public:
+  SearchResult() : status(SEARCH_COMPLETE), lower_bound(0), states_explored(0) {}
+
+  SearchStatus status;
+  // No solution uses fewer moves than this. When the search completes with
+  // solutions, this is their length.
+  int lower_bound;
+  // The winning states found (each with every path to it if all_paths was
+  // set). If the search was cancelled this is the best found so far, if any.
+  std::vector<BoardState> solutions;
+  // Number of states taken off the queue and expanded
+  long states_explored;
+  // what went wrong, when the status is SEARCH_ERROR
+  std::string error;
+};
+
+
+// ==================================================================
+// ==================================================================
+// Keeps track of the time and memory a search has used against the limits
+// in its options. exceeded() is meant to be called in the inner loop, so it
+// only actually looks at the clock every so often.
+
+class SearchBudget {
+public:
+  SearchBudget(const SearchOptions &options);
+
+  // bytes are added as states are stored, and removed when they are dropped
+  void use(long bytes) { memory_used += bytes; }
+  void release(long bytes) { memory_used -= bytes; }
+  // the visited set keeps track of its own size, which is counted on top
+  void setTableBytes(long bytes) { table_bytes = bytes; }
+  long memoryUsed() const { return memory_used + table_bytes; }
+  long memoryLeft() const { return memory_limit - memoryUsed(); }
+  // changes the memory limit, clearing the status if it was over the old one
+  void setMemoryLimit(long bytes);
+  // once the flag is set, the search counts as over the limits with the
+  // status SEARCH_CANCELLED (it may be set from another thread)
+  void setCancelFlag(const std::atomic<bool> *flag) { cancel_flag = flag; }
+
+  // true once either limit is passed, and status says which one
+  bool exceeded();
+  SearchStatus status;
+
+private:
+  std::chrono::steady_clock::time_point deadline;
+  bool has_deadline;
+  long memory_limit;
+  long memory_used;
+  long table_bytes;
+  int calls;
+  const std::atomic<bool> *cancel_flag;
+};
+
+
+// ==================================================================
+// ==================================================================
+// The searches
+
+// Breadth first search finding the shortest solution (or all of them)
+SearchResult bf_path_finder(Board *board, const SearchOptions &options);
+
+
+// A search for the shortest solution run a few states at a time, so whatever
+// is running it can get on with other things in between (see solver.h).
+// Everything it needs is kept in between calls to step.
+class PathFinder {
+public:
+  virtual ~PathFinder() {}
+
+  // Expands up to max_states more states. Returns true once the search is
+  // over, with the answer in result().
+  virtual bool step(long max_states) = 0;
+  // Stops the search at its next chance, with the status SEARCH_CANCELLED.
+  // May be called from another thread.
+  virtual void cancel() = 0;
+  virtual bool done() const = 0;
+
+  // How far the search has got: the states explored and the lower bound, and
+  // once it's done the status and the solutions
+  virtual const SearchResult &result() const = 0;
+  // The length of a solution known to exist (-1 if none is known yet)
+  virtual int upperBound() const = 0;
+};
+
+// The search bf_path_finder runs in this process for the options (the
+// number of processes is ignored). The board has to outlast it.
+PathFinder *newPathFinder(Board *board, const SearchOptions &options);
+
+
+// The breadth first search over a queue of BoardStates, which keeps the path
+// to each state with it. This is the one that can find every shortest path,
+// switch to iterative deepening when memory runs out (the deepening is run a
+// few states at a time as well) and take snapshots.
+class QueueSearch;
+
+class QueuePathFinder : public PathFinder {
+public:
+  QueuePathFinder(Board *board, const SearchOptions &options);
+  ~QueuePathFinder();
+
+  bool step(long max_states);
+  void cancel();
+  bool done() const;
+  const SearchResult &result() const;
+  int upperBound() const;
+
+private:
+  QueuePathFinder(const QueuePathFinder &);
+  QueuePathFinder &operator=(const QueuePathFinder &);
+
+  QueueSearch *search;
+};
+
+// The fewest moves a robot that can win needs to get to the goal on its own,
+// with the others standing still (-1 if none can). That is an actual
+// solution, so no shortest one is longer.
+int single_robot_bound(const Board *board);
+
+// The same for a robot that can win and one other robot moving, so it is
+// never longer, and quite often it is as short as the puzzle gets. The moves
+// left for PRUNE_BLOCKERS are counted against it when there's no cap on the
+// number of moves. Boards bigger than 16 by 16 only get the one robot bound.
+int helper_robot_bound(const Board *board);
+
+// The number of moves left for reaching the goal from a state depth moves in,
+// going by the move cap or else the bound above (-1 if there's neither)
+inline int moves_left(int bound, int depth) { return (bound == -1) ? -1 : std::max(bound - depth, 0); }
+
+// Breadth first search recording, for each cell, the fewest moves it takes
+// for any robot to get there (-1 if none can). If result is given it is
+// filled in with how the search ended. If robot_grids is given, it is filled
+// in with the same thing for each robot separately (indexed by robot, then
+// row and column) during the same search. Telling the robots apart means
+// states with the other robots swapped around can't be merged, so the search
+// may have more states to go through.
+std::vector<std::vector<int> > bf_accessibility(Board *board, const SearchOptions &options,
+                                                SearchResult *result = NULL,
+                                                std::vector<std::vector<std::vector<int> > > *robot_grids = NULL);
+
+#endif
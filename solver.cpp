@@ -0,0 +1,104 @@
+#include <thread>
+
+#include "solver.h"
+
+
+// A solve in the pool, with its own copy of the board
+class SolveEntry {
+public:
+  SolveEntry(const Board &b, const SearchOptions &o, SolveCallback c)
+    : id(0), board(b), options(o), callback(c) {}
+
+  long id;
+  Board board;
+  SearchOptions options;
+  SolveCallback callback;
+  std::unique_ptr<PathFinder> finder;
+};
+
+// Runs the next slice of a solve
+static SolveProgress advance(SolveEntry &entry, long slice_states) {
+  SolveProgress progress;
+  progress.id = entry.id;
+  progress.finished = entry.finder->step(slice_states);
+  progress.result = entry.finder->result();
+  progress.upper_bound = entry.finder->upperBound();
+  return progress;
+}
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the SolvePool class
+
+long SolvePool::submit(const Board &board, const SearchOptions &options, SolveCallback callback) {
+  std::shared_ptr<SolveEntry> entry(new SolveEntry(board, options, callback));
+  entry->finder.reset(newPathFinder(&entry->board, entry->options));
+  std::lock_guard<std::mutex> lock(mutex);
+  entry->id = next_id++;
+  entries[entry->id] = entry;
+  waiting.push_back(entry);
+  changed.notify_all();
+  return entry->id;
+}
+
+bool SolvePool::cancel(long id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::map<long, std::shared_ptr<SolveEntry> >::iterator itr = entries.find(id);
+  if (itr == entries.end())
+    return false;
+  itr->second->finder->cancel();
+  return true;
+}
+
+bool SolvePool::runSlice() {
+  std::shared_ptr<SolveEntry> entry;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (waiting.empty())
+      return false;
+    entry = waiting.front();
+    waiting.pop_front();
+    running++;
+  }
+  // (the entry is only ever in one thread's hands, so no lock is needed)
+  SolveProgress progress = advance(*entry, slice_states);
+  entry->callback(progress);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running--;
+    if (progress.finished)
+      entries.erase(entry->id);
+    else
+      waiting.push_back(entry);
+  }
+  changed.notify_all();
+  return true;
+}
+
+void SolvePool::run(int threads) {
+  // a thread with nothing to run waits, since a slice being run by another
+  // may yet put its solve back in line or submit more
+  std::function<void()> work = [this]() {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() { return !waiting.empty() || running == 0; });
+        if (waiting.empty())
+          return;
+      }
+      runSlice();
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int t = 1; t < threads; ++t)
+    workers.push_back(std::thread(work));
+  work();
+  for (int t = 0; t < workers.size(); ++t)
+    workers[t].join();
+}
+
+long SolvePool::size() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.size();
+}
@@ -0,0 +1,87 @@
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+#include "board.h"
+#include "search.h"
+
+#ifndef _solver_h_
+#define _solver_h_
+
+// ==================================================================
+// ==================================================================
+// Runs many solves at once on a few threads, without a thread for each.
+//
+// Each solve is run a slice at a time (up to slice_states states expanded)
+// and then goes to the back of the line, so a long solve can't hold up the
+// others and every solve gets its turn. After each slice the solve's
+// callback is called with how far it has got: the states explored and the
+// lower bound so far, the length of a solution known to exist, and once it
+// is finished the whole result. Callbacks are called on whichever thread ran
+// the slice, but never for the same solve on two threads at once. They may
+// submit or cancel solves.
+//
+// Every solve is the search bf_path_finder would run in one process (see
+// PathFinder in search.h), so options.processes is ignored: the solves are
+// already spread over the pool's threads.
+
+class SolveProgress {
+public:
+  SolveProgress() : id(0), finished(false), upper_bound(-1) {}
+
+  long id;
+  // whether this is the last call for the solve, and result is the answer
+  bool finished;
+  // how far the solve has got (see SearchResult), which is the answer once
+  // it is finished
+  SearchResult result;
+  // the length of a solution known to exist (-1 if none is known yet)
+  int upper_bound;
+};
+
+typedef std::function<void(const SolveProgress &)> SolveCallback;
+
+class SolveEntry;
+
+class SolvePool {
+public:
+  SolvePool(long slice_states = 100000) : slice_states(slice_states), next_id(1), running(0) {}
+
+  // Adds a solve to the back of the line and returns its id. The board is
+  // copied, and the time limit in the options counts from now.
+  long submit(const Board &board, const SearchOptions &options, SolveCallback callback);
+  // Stops a solve, which is then finished with the status SEARCH_CANCELLED.
+  // A slice already running stops after the chunk of states it is on.
+  // Returns false if there's no such solve still going.
+  bool cancel(long id);
+
+  // Runs one slice of the solve at the front of the line. Returns false if
+  // there was nothing waiting to run.
+  bool runSlice();
+  // Runs slices on this many threads (this one among them) until every
+  // solve, including any submitted along the way, is finished
+  void run(int threads);
+
+  // the number of solves not finished yet
+  long size();
+
+private:
+  SolvePool(const SolvePool &);
+  SolvePool &operator=(const SolvePool &);
+
+  long slice_states;
+  long next_id;
+  // the solves waiting for their next slice, and every solve not finished
+  std::deque<std::shared_ptr<SolveEntry> > waiting;
+  std::map<long, std::shared_ptr<SolveEntry> > entries;
+  // the number of slices being run right now
+  int running;
+  std::mutex mutex;
+  std::condition_variable changed;
+};
+
+#endif
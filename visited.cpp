@@ -0,0 +1,424 @@
+#include <iostream>
+#include <algorithm>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "visited.h"
+
+
+// ==================================================================
+// ==================================================================
+// Packing states
+
+int cellBits(const Board *board) {
+  int bits = 1;
+  while ((1LL << bits) < (long long)board->getRows() * board->getCols())
+    bits++;
+  return bits;
+}
+
+bool fitsPacked(const Board *board) {
+  return stateBits(board) <= 64;
+}
+
+int keyWords(const Board *board) {
+  int words = (stateBits(board) + 63) / 64;
+  if (words <= 2)
+    return 2;
+  if (words <= 4)
+    return 4;
+  if (words <= 7)
+    return 7;
+  return MAX_KEY_WORDS;
+}
+
+StatePacker::StatePacker(const Board *board, bool sym) {
+  num_cells = board->getRows() * board->getCols();
+  num_robots = board->numRobots();
+  assert (num_robots <= MAX_ROBOTS);
+  bits = cellBits(board);
+  assert (bits <= 31);
+  symmetric = sym;
+  // (-1, for no fixed robot, if any robot can reach the goal or there isn't
+  // one set yet)
+  int goal_robot = board->getGoalRobot();
+  fixed_robot = (symmetric && goal_robot >= 0 && goal_robot < num_robots) ? goal_robot : -1;
+  num_ranks = 0;
+  // (the dense set is no use on boards too big for the table to be worth
+  // working out)
+  if (!fitsPacked(board) || num_cells > 65536)
+    return;
+
+  binomial = std::vector<std::vector<unsigned long long> >(num_cells + 1,
+    std::vector<unsigned long long>(num_robots + 1, 0));
+  for (int n = 0; n <= num_cells; ++n) {
+    binomial[n][0] = 1;
+    for (int k = 1; k <= num_robots && k <= n; ++k) {
+      binomial[n][k] = binomial[n-1][k-1] + (k <= n - 1 ? binomial[n-1][k] : 0);
+    }
+  }
+
+  if (symmetric) {
+    int free_robots = num_robots - (fixed_robot == -1 ? 0 : 1);
+    num_ranks = binomial[num_cells][free_robots];
+    if (fixed_robot != -1) {
+      if (num_ranks > (1ULL << 62) / num_cells)
+        num_ranks = 0;
+      num_ranks *= num_cells;
+    }
+  }
+  else {
+    // every robot on every cell, unless that doesn't fit
+    num_ranks = 1;
+    for (int i = 0; i < num_robots; ++i) {
+      if (num_ranks > (1ULL << 62) / num_cells) {
+        num_ranks = 0;
+        break;
+      }
+      num_ranks *= num_cells;
+    }
+  }
+}
+
+void StatePacker::cells(const BoardState &s, int *out) const {
+  int cols = s.board->getCols();
+  for (int i = 0; i < num_robots; ++i) {
+    out[i] = (s.bots[i].row - 1) * cols + (s.bots[i].col - 1);
+  }
+  sortCells(out);
+}
+
+void StatePacker::sortCells(int *out) const {
+  if (symmetric) {
+    // sort the interchangeable robots' cells into the slots they use
+    int free_cells[MAX_ROBOTS];
+    int n = 0;
+    for (int i = 0; i < num_robots; ++i) {
+      if (i != fixed_robot)
+        free_cells[n++] = out[i];
+    }
+    // (insertion sort, there are only a few of them)
+    for (int i = 1; i < n; ++i) {
+      int cell = free_cells[i];
+      int j = i;
+      for (; j > 0 && free_cells[j-1] > cell; --j)
+        free_cells[j] = free_cells[j-1];
+      free_cells[j] = cell;
+    }
+    n = 0;
+    for (int i = 0; i < num_robots; ++i) {
+      if (i != fixed_robot)
+        out[i] = free_cells[n++];
+    }
+  }
+}
+
+PackedState StatePacker::pack(const BoardState &s) const {
+  int c[MAX_ROBOTS];
+  cells(s, c);
+  PackedState key = 0;
+  for (int i = 0; i < num_robots; ++i) {
+    key |= (PackedState)c[i] << (bits * i);
+  }
+  return key;
+}
+
+PackedState StatePacker::pack(const int *robot_cells) const {
+  int c[MAX_ROBOTS];
+  for (int i = 0; i < num_robots; ++i)
+    c[i] = robot_cells[i];
+  sortCells(c);
+  PackedState key = 0;
+  for (int i = 0; i < num_robots; ++i) {
+    key |= (PackedState)c[i] << (bits * i);
+  }
+  return key;
+}
+
+unsigned long long StatePacker::rank(PackedState key) const {
+  unsigned long long r = 0;
+  PackedState mask = (1ULL << bits) - 1;
+  if (symmetric) {
+    // the free cells are already in increasing order
+    int n = 0;
+    for (int i = 0; i < num_robots; ++i) {
+      if (i == fixed_robot)
+        continue;
+      int cell = (key >> (bits * i)) & mask;
+      r += binomial[cell][n + 1];
+      n++;
+    }
+    if (fixed_robot != -1) {
+      int cell = (key >> (bits * fixed_robot)) & mask;
+      r += cell * binomial[num_cells][n];
+    }
+  }
+  else {
+    for (int i = num_robots - 1; i >= 0; --i) {
+      r = r * num_cells + ((key >> (bits * i)) & mask);
+    }
+  }
+  return r;
+}
+
+
+// ==================================================================
+// ==================================================================
+// Choosing a visited set
+
+// A dense set is only picked before the search starts if it's at most this
+// big; the guess at how many states can be reached is very rough, so past
+// that the search starts with a hash table and switches once it has actually
+// seen enough states.
+static const long EAGER_DENSE_BYTES = 16L * 1024 * 1024;
+
+VisitedSet *newVisitedSet(const Board *board, bool symmetric, int max_moves) {
+  StatePacker packer(board, symmetric);
+  if (!fitsPacked(board)) {
+    switch (keyWords(board)) {
+    case 2: return new WideVisitedSet<WideKey<2>, WideKeyHash<2> >(packer);
+    case 4: return new WideVisitedSet<WideKey<4>, WideKeyHash<4> >(packer);
+    case 7: return new WideVisitedSet<WideKey<7>, WideKeyHash<7> >(packer);
+    }
+    return new WideVisitedSet<WideKey<MAX_KEY_WORDS>, WideKeyHash<MAX_KEY_WORDS> >(packer);
+  }
+  unsigned long long ranks = packer.numRanks();
+  if (ranks != 0 && max_moves != -1) {
+    // at most 4 moves per robot from each state
+    double projected = 0;
+    double paths = 1;
+    for (int i = 0; i <= max_moves && projected < ranks; ++i) {
+      projected += paths;
+      paths *= 4 * board->numRobots();
+    }
+    projected = std::min(projected, (double)ranks);
+    long dense_bytes = DenseVisitedSet::bytesFor(ranks);
+    if (dense_bytes <= EAGER_DENSE_BYTES && projected * HashVisitedSet::bytesPerState() >= dense_bytes) {
+      DenseVisitedSet *dense = new DenseVisitedSet(packer);
+      if (dense->ok())
+        return dense;
+      delete dense;
+    }
+  }
+  return new AutoVisitedSet(packer);
+}
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the hash table set
+
+int HashVisitedSet::insert(const BoardState &s, int depth) {
+  std::pair<std::unordered_map<PackedState, int>::iterator, bool> res =
+    depths.insert(std::make_pair(packer.pack(s), depth));
+  if (res.second)
+    return VISITED_NEW;
+  return (res.first->second == depth) ? VISITED_SAME_DEPTH : VISITED_EARLIER;
+}
+
+int HashVisitedSet::depth(const BoardState &s) const {
+  std::unordered_map<PackedState, int>::const_iterator itr = depths.find(packer.pack(s));
+  if (itr == depths.end())
+    return -1;
+  return itr->second;
+}
+
+long HashVisitedSet::bytesPerState() {
+  // a node holding the key, value, next pointer and cached hash, plus about
+  // one bucket pointer per node
+  return sizeof(std::pair<PackedState, int>) + 2 * sizeof(void *) + sizeof(size_t);
+}
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the dense set
+
+// masks picking out the high and low bit of every 2 bit entry in a word
+static const unsigned long long HIGH_BITS = 0xAAAAAAAAAAAAAAAAULL;
+static const unsigned long long LOW_BITS = 0x5555555555555555ULL;
+
+// the size of a huge page, which is what gets backed at once once the array
+// is advised to use them
+static const long HUGE_PAGE_BYTES = 2L * 1024 * 1024;
+
+// what page_marks says about a page
+static const unsigned char PAGE_TOUCHED = 1;
+static const unsigned char PAGE_RECENT = 2;
+
+long DenseVisitedSet::bytesFor(unsigned long long num_ranks) {
+  return (num_ranks + 31) / 32 * sizeof(unsigned long long);
+}
+
+DenseVisitedSet::DenseVisitedSet(const StatePacker &p) : packer(p) {
+  count = 0;
+  level = 0;
+  touched_pages = 0;
+  num_words = bytesFor(packer.numRanks()) / sizeof(unsigned long long);
+  // mmap hands back zeroed, page aligned memory, and only pages that get
+  // written to are actually backed by memory
+  void *mem = mmap(NULL, num_words * sizeof(unsigned long long), PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (mem == MAP_FAILED) {
+    std::cerr << "WARNING: could not allocate " << num_words * sizeof(unsigned long long)
+              << " bytes for the visited states" << std::endl;
+    words = NULL;
+    num_words = 0;
+    page_words = 1;
+    return;
+  }
+  long page_bytes = sysconf(_SC_PAGESIZE);
+#ifdef MADV_HUGEPAGE
+  if (madvise(mem, num_words * sizeof(unsigned long long), MADV_HUGEPAGE) == 0)
+    page_bytes = HUGE_PAGE_BYTES;
+#endif
+  words = (unsigned long long *)mem;
+  page_words = page_bytes / sizeof(unsigned long long);
+  page_marks.assign((num_words + page_words - 1) / page_words, 0);
+}
+
+DenseVisitedSet::~DenseVisitedSet() {
+  if (words != NULL)
+    munmap(words, num_words * sizeof(unsigned long long));
+}
+
+long DenseVisitedSet::memoryUsage() const {
+  return touched_pages * page_words * sizeof(unsigned long long) + page_marks.size() +
+    recent_pages.capacity() * sizeof(long);
+}
+
+// Everything marked as being at the deepest depth becomes earlier. Only the
+// pages states were added to since the last time can have any.
+void DenseVisitedSet::startDepth(int depth) {
+  for (long p = 0; p < recent_pages.size(); ++p) {
+    long page = recent_pages[p];
+    long end = std::min((page + 1) * page_words, num_words);
+    for (long i = page * page_words; i < end; ++i) {
+      unsigned long long high = words[i] & HIGH_BITS;
+      if (high != 0)
+        words[i] = (words[i] & LOW_BITS) | (high >> 1);
+    }
+    page_marks[page] &= ~PAGE_RECENT;
+  }
+  recent_pages.clear();
+  level = depth;
+}
+
+int DenseVisitedSet::insertKey(PackedState key, int depth) {
+  if (depth > level)
+    startDepth(depth);
+  unsigned long long r = packer.rank(key);
+  unsigned long long &word = words[r >> 5];
+  int shift = (r & 31) * 2;
+  int mark = (word >> shift) & 3;
+  if (mark == 0) {
+    word |= 2ULL << shift;
+    count++;
+    long page = (r >> 5) / page_words;
+    if (!(page_marks[page] & PAGE_RECENT)) {
+      if (!(page_marks[page] & PAGE_TOUCHED))
+        touched_pages++;
+      page_marks[page] |= PAGE_TOUCHED | PAGE_RECENT;
+      recent_pages.push_back(page);
+    }
+    return VISITED_NEW;
+  }
+  return (mark == 2 && depth == level) ? VISITED_SAME_DEPTH : VISITED_EARLIER;
+}
+
+int DenseVisitedSet::insert(const BoardState &s, int depth) {
+  return insertKey(packer.pack(s), depth);
+}
+
+int DenseVisitedSet::depth(const BoardState &s) const {
+  unsigned long long r = packer.rank(packer.pack(s));
+  int mark = (words[r >> 5] >> ((r & 31) * 2)) & 3;
+  if (mark == 0)
+    return -1;
+  return (mark == 2) ? level : level - 1;
+}
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the set that switches from hash table to dense
+
+int AutoVisitedSet::insert(const BoardState &s, int depth) {
+  if (dense != NULL)
+    return dense->insert(s, depth);
+  int res = hash->insert(s, depth);
+  if (res == VISITED_NEW && !stay_hash &&
+      hash->memoryUsage() >= DenseVisitedSet::bytesFor(packer.numRanks())) {
+    switchToDense();
+  }
+  return res;
+}
+
+int AutoVisitedSet::depth(const BoardState &s) const {
+  return dense ? dense->depth(s) : hash->depth(s);
+}
+
+void AutoVisitedSet::switchToDense() {
+  DenseVisitedSet *d = new DenseVisitedSet(packer);
+  if (!d->ok()) {
+    // couldn't get the memory, so stay a hash table for good
+    delete d;
+    stay_hash = true;
+    return;
+  }
+  int level = 0;
+  std::unordered_map<PackedState, int>::iterator itr;
+  for (itr = hash->depths.begin(); itr != hash->depths.end(); ++itr) {
+    level = std::max(level, itr->second);
+  }
+  d->level = level;
+  for (itr = hash->depths.begin(); itr != hash->depths.end(); ++itr) {
+    d->insertKey(itr->first, level);
+    if (itr->second != level) {
+      // mark it as earlier instead
+      unsigned long long r = packer.rank(itr->first);
+      d->words[r >> 5] ^= 3ULL << ((r & 31) * 2);
+    }
+  }
+  dense = d;
+  delete hash;
+  hash = NULL;
+}
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the wide key sets
+
+template <class Key, class Hash>
+int WideVisitedSet<Key, Hash>::insert(const BoardState &s, int depth) {
+  Key key;
+  packer.pack(s, key);
+  std::pair<typename std::unordered_map<Key, int, Hash>::iterator, bool> res =
+    depths.insert(std::make_pair(key, depth));
+  if (res.second)
+    return VISITED_NEW;
+  return (res.first->second == depth) ? VISITED_SAME_DEPTH : VISITED_EARLIER;
+}
+
+template <class Key, class Hash>
+int WideVisitedSet<Key, Hash>::depth(const BoardState &s) const {
+  Key key;
+  packer.pack(s, key);
+  typename std::unordered_map<Key, int, Hash>::const_iterator itr = depths.find(key);
+  if (itr == depths.end())
+    return -1;
+  return itr->second;
+}
+
+template <class Key, class Hash>
+long WideVisitedSet<Key, Hash>::memoryUsage() const {
+  // as for the hash table set, with the wider key in the node
+  long per_state = sizeof(std::pair<Key, int>) + 2 * sizeof(void *) + sizeof(size_t);
+  return depths.size() * per_state;
+}
+
+template class WideVisitedSet<WideKey<2>, WideKeyHash<2> >;
+template class WideVisitedSet<WideKey<4>, WideKeyHash<4> >;
+template class WideVisitedSet<WideKey<7>, WideKeyHash<7> >;
+template class WideVisitedSet<WideKey<MAX_KEY_WORDS>, WideKeyHash<MAX_KEY_WORDS> >;
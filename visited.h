@@ -0,0 +1,295 @@
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+#include "board.h"
+#include "boardstate.h"
+
+#ifndef _visited_h_
+#define _visited_h_
+
+// ==================================================================
+// ==================================================================
+// A board state packed into a fixed width key: cellBits(board) bits per robot
+// holding the index of the cell it is on. How wide the key is depends on the
+// board:
+//   PackedState  a single integer, when every robot fits in 64 bits (16x16
+//                with up to 8 robots, 32x32 with up to 6). Check fitsPacked.
+//   WideKey<N>   N of them, the fewest of 2, 4, 7 or MAX_KEY_WORDS that hold
+//                the state (keyWords). 2 is enough for 32x32 with up to 12
+//                robots, and 7 for every robot on a board of up to 256x256.
+// Keys are built in place, so packing a state never allocates anything.
+
+typedef unsigned long long PackedState;
+
+// A board has fewer than 2^31 cells (they are numbered with ints), so a cell
+// never takes more than 31 bits, and this many words hold any state
+const int MAX_KEY_WORDS = (MAX_ROBOTS * 31 + 63) / 64;
+
+// the number of bits it takes to store a cell index
+int cellBits(const Board *board);
+// the number of bits a whole state takes
+inline int stateBits(const Board *board) { return cellBits(board) * board->numRobots(); }
+bool fitsPacked(const Board *board);
+// the number of words in the WideKey a state goes in, when it doesn't fit in
+// a PackedState (2, 4, 7 or MAX_KEY_WORDS)
+int keyWords(const Board *board);
+
+template <int WORDS>
+class WideKey {
+public:
+  WideKey() { for (int i = 0; i < WORDS; ++i) words[i] = 0; }
+
+  // Stores value in the bits bits starting at bit offset (which may run over
+  // into the next word)
+  void set(int offset, unsigned long long value, int bits) {
+    words[offset / 64] |= value << (offset % 64);
+    if (offset % 64 + bits > 64)
+      words[offset / 64 + 1] |= value >> (64 - offset % 64);
+  }
+  // the value in those bits
+  unsigned long long get(int offset, int bits) const {
+    unsigned long long value = words[offset / 64] >> (offset % 64);
+    if (offset % 64 + bits > 64)
+      value |= words[offset / 64 + 1] << (64 - offset % 64);
+    return value & ((1ULL << bits) - 1);
+  }
+  // set, over whatever was in those bits before
+  void replace(int offset, unsigned long long value, int bits) {
+    unsigned long long mask = (1ULL << bits) - 1;
+    words[offset / 64] &= ~(mask << (offset % 64));
+    if (offset % 64 + bits > 64)
+      words[offset / 64 + 1] &= ~(mask >> (64 - offset % 64));
+    set(offset, value, bits);
+  }
+  bool operator==(const WideKey &k) const {
+    for (int i = 0; i < WORDS; ++i) {
+      if (words[i] != k.words[i])
+        return false;
+    }
+    return true;
+  }
+
+  unsigned long long words[WORDS];
+};
+
+template <int WORDS>
+class WideKeyHash {
+public:
+  size_t operator()(const WideKey<WORDS> &k) const {
+    // neighbouring states differ in a single field, so mix every word in
+    unsigned long long h = 0;
+    for (int i = 0; i < WORDS; ++i) {
+      h = (h ^ k.words[i]) * 0x9E3779B97F4A7C15ULL;
+      h ^= h >> 29;
+    }
+    return h;
+  }
+};
+
+// Packs states and numbers them. When symmetric is set, robots that aren't
+// the goal robot are treated as interchangeable (any of them could play the
+// part of any other), so states that only differ by which of them is where
+// pack to the same value.
+class StatePacker {
+public:
+  StatePacker(const Board *board, bool symmetric);
+
+  // for boards where fitsPacked is true, from a state or from the cell each
+  // robot is on
+  PackedState pack(const BoardState &s) const;
+  PackedState pack(const int *robot_cells) const;
+  void pack(const int *robot_cells, PackedState &key) const { key = pack(robot_cells); }
+  // for any board (WideKey<WORDS> needs WORDS * 64 >= stateBits(board))
+  template <int WORDS>
+  void pack(const BoardState &s, WideKey<WORDS> &key) const;
+  template <int WORDS>
+  void pack(const int *robot_cells, WideKey<WORDS> &key) const;
+
+  // Numbers packed states densely from 0 to numRanks() - 1. For symmetric
+  // packers this uses the combinatorial number system on the sorted cells of
+  // the interchangeable robots. numRanks() is 0 if they don't fit in 64 bits.
+  unsigned long long rank(PackedState key) const;
+  unsigned long long numRanks() const { return num_ranks; }
+
+  int bitsPerCell() const { return bits; }
+
+private:
+  // the cell each robot is on, with the interchangeable robots' cells sorted
+  void cells(const BoardState &s, int *out) const;
+  void sortCells(int *cells) const;
+
+  int num_cells;
+  int num_robots;
+  int bits;
+  // the robot kept apart from the interchangeable ones (-1 for none)
+  int fixed_robot;
+  bool symmetric;
+  unsigned long long num_ranks;
+  // binomial[n][k] = n choose k, for n <= num_cells and k <= num_robots
+  // (only worked out when states fit in a PackedState)
+  std::vector<std::vector<unsigned long long> > binomial;
+};
+
+template <int WORDS>
+void StatePacker::pack(const BoardState &s, WideKey<WORDS> &key) const {
+  int c[MAX_ROBOTS];
+  cells(s, c);
+  key = WideKey<WORDS>();
+  for (int i = 0; i < num_robots; ++i)
+    key.set(bits * i, c[i], bits);
+}
+
+template <int WORDS>
+void StatePacker::pack(const int *robot_cells, WideKey<WORDS> &key) const {
+  int c[MAX_ROBOTS];
+  std::copy(robot_cells, robot_cells + num_robots, c);
+  sortCells(c);
+  key = WideKey<WORDS>();
+  for (int i = 0; i < num_robots; ++i)
+    key.set(bits * i, c[i], bits);
+}
+
+
+// ==================================================================
+// ==================================================================
+// The set of states a search has already seen, along with the number of
+// moves it took to first get to each one.
+
+// what VisitedSet::insert found
+const int VISITED_NEW = 0;        // never seen before, now added
+const int VISITED_SAME_DEPTH = 1; // already seen with the same number of moves
+const int VISITED_EARLIER = 2;    // already seen with fewer moves
+
+class VisitedSet {
+public:
+  virtual ~VisitedSet() {}
+
+  // Adds the state if it hasn't been seen, reached in depth moves. Because
+  // the searches are breadth first, a state that is already there was always
+  // reached in the same or fewer moves, and depth never goes down from one
+  // call to the next.
+  virtual int insert(const BoardState &s, int depth) = 0;
+  // The number of moves the state was first reached in, or -1 if it hasn't
+  // been. Some sets only remember the exact number for states at the deepest
+  // depth so far, and give one less than that for anything earlier.
+  virtual int depth(const BoardState &s) const = 0;
+
+  virtual long size() const = 0;
+  // Rough number of bytes the set is taking up
+  virtual long memoryUsage() const = 0;
+};
+
+// Picks the best kind of set for the board. symmetric is passed on to the
+// StatePacker; max_moves (if not -1) is used to guess how many states the
+// search could possibly reach.
+VisitedSet *newVisitedSet(const Board *board, bool symmetric, int max_moves = -1);
+
+
+// Hash table keyed on the packed state, for boards where fitsPacked is true
+class HashVisitedSet : public VisitedSet {
+public:
+  HashVisitedSet(const StatePacker &p) : packer(p) {}
+
+  int insert(const BoardState &s, int depth);
+  int depth(const BoardState &s) const;
+  long size() const { return depths.size(); }
+  long memoryUsage() const { return depths.size() * bytesPerState(); }
+
+  // Rough number of bytes each added state costs
+  static long bytesPerState();
+
+  friend class AutoVisitedSet;
+
+private:
+  StatePacker packer;
+  std::unordered_map<PackedState, int> depths;
+};
+
+
+// Two bits for every possible state, indexed by the packer's rank: 0 for not
+// seen, 2 for seen at the deepest depth so far and 1 for seen before that.
+// The array is reserved up front (page aligned, and untouched pages don't
+// take up real memory until they're written to). Whenever the depth goes up,
+// the pages that had states added at the old depth are swept to turn 2s into
+// 1s. memoryUsage only counts the pages that have been written to.
+class DenseVisitedSet : public VisitedSet {
+public:
+  DenseVisitedSet(const StatePacker &p);
+  ~DenseVisitedSet();
+
+  int insert(const BoardState &s, int depth);
+  int depth(const BoardState &s) const;
+  long size() const { return count; }
+  long memoryUsage() const;
+
+  // false if the array couldn't be reserved
+  bool ok() const { return words != NULL; }
+
+  // Bytes the array takes for a packer with this many ranks
+  static long bytesFor(unsigned long long num_ranks);
+
+  friend class AutoVisitedSet;
+
+private:
+  int insertKey(PackedState key, int depth);
+  void startDepth(int depth);
+
+  StatePacker packer;
+  unsigned long long *words;
+  long num_words;
+  long count;
+  // the deepest depth inserted so far
+  int level;
+  // words per page (a huge page if the array got them), which pages have
+  // been written to, and which have states at the deepest depth
+  long page_words;
+  std::vector<unsigned char> page_marks;
+  std::vector<long> recent_pages;
+  long touched_pages;
+};
+
+
+// Starts out as a hash table and moves everything over to a dense array once
+// enough states have been seen that the array would take less memory.
+class AutoVisitedSet : public VisitedSet {
+public:
+  AutoVisitedSet(const StatePacker &p) : packer(p), hash(new HashVisitedSet(p)), dense(NULL),
+    stay_hash(p.numRanks() == 0) {}
+  ~AutoVisitedSet() { delete hash; delete dense; }
+
+  int insert(const BoardState &s, int depth);
+  int depth(const BoardState &s) const;
+  long size() const { return dense ? dense->size() : hash->size(); }
+  long memoryUsage() const { return dense ? dense->memoryUsage() : hash->memoryUsage(); }
+
+private:
+  void switchToDense();
+
+  StatePacker packer;
+  HashVisitedSet *hash;
+  DenseVisitedSet *dense;
+  // set if the dense array is too big to number, or couldn't be allocated
+  bool stay_hash;
+};
+
+
+// Hash table keyed on a wider key, for boards where fitsPacked is false. The
+// code for hashing and comparing is specialized for each width of key.
+template <class Key, class Hash>
+class WideVisitedSet : public VisitedSet {
+public:
+  WideVisitedSet(const StatePacker &p) : packer(p) {}
+
+  int insert(const BoardState &s, int depth);
+  int depth(const BoardState &s) const;
+  long size() const { return depths.size(); }
+  long memoryUsage() const;
+
+private:
+  StatePacker packer;
+  std::unordered_map<Key, int, Hash> depths;
+};
+
+#endif